@@ -0,0 +1,133 @@
+#include "activity.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace bd {
+
+void ActivityTracker::configure(double width, double height, double cell_size,
+                                double threshold, int frames)
+{
+  if (cell_size <= 0. || width <= 0. || height <= 0.)
+    throw std::invalid_argument("Griglia di attività non valida");
+  if (threshold < 0.)
+    throw std::invalid_argument("La soglia di attività non può essere "
+                                "negativa");
+  if (frames < 1)
+    throw std::invalid_argument("Serve almeno un frame di quiete");
+  cell         = cell_size;
+  nx           = static_cast<size_t>(std::ceil(width / cell));
+  ny           = static_cast<size_t>(std::ceil(height / cell));
+  threshold2   = threshold * threshold;
+  quiet_frames = frames;
+  reset();
+}
+
+void ActivityTracker::reset()
+{
+  quiet.assign(nx * ny, 0);
+  asleep.assign(nx * ny, 0);
+  change2.assign(nx * ny, 0.);
+  resting.clear();
+  cell_of.clear();
+  n_resting = 0;
+}
+
+size_t ActivityTracker::cell_index(const Position& p) const
+{
+  auto axis = [this](double v, size_t n) {
+    if (!(v > 0.)) // anche NaN
+      return size_t{0};
+    return std::min(static_cast<size_t>(v / cell), n - 1);
+  };
+  return axis(p[1], ny) * nx + axis(p[0], nx);
+}
+
+void ActivityTracker::wake(size_t c)
+{
+  asleep[c] = 0;
+  quiet[c]  = 0;
+}
+
+void ActivityTracker::wake_at(const Position& p, double radius)
+{
+  if (asleep.empty())
+    return;
+  const size_t c0 = cell_index({p[0] - radius, p[1] - radius});
+  const size_t c1 = cell_index({p[0] + radius, p[1] + radius});
+  for (size_t cy = c0 / nx; cy <= c1 / nx; ++cy)
+    for (size_t cx = c0 % nx; cx <= c1 % nx; ++cx)
+      wake(cy * nx + cx);
+}
+
+void ActivityTracker::begin_frame(const std::vector<Boid>& b)
+{
+  if (asleep.empty())
+    return;
+  // i boids aggiunti dopo l'ultimo frame partono svegli
+  const size_t known = cell_of.size();
+  resting.resize(b.size(), 0);
+  cell_of.resize(b.size());
+  for (size_t i = 0; i < b.size(); ++i) {
+    const size_t c = cell_index(b[i].pos);
+    // un boid sveglio che entra in una cella addormentata la sveglia
+    if (resting[i] == 0 && asleep[c] != 0 && (i >= known || c != cell_of[i]))
+      wake(c);
+    cell_of[i] = c;
+  }
+  n_resting = 0;
+  for (size_t i = 0; i < b.size(); ++i) {
+    resting[i] = asleep[cell_of[i]];
+    n_resting += resting[i];
+  }
+}
+
+void ActivityTracker::end_frame(const std::vector<Boid>& b,
+                                const std::vector<Velocity>& vel_tot)
+{
+  if (asleep.empty())
+    return;
+  std::fill(change2.begin(), change2.end(), 0.);
+  for (size_t i = 0; i < b.size(); ++i) {
+    if (resting[i] != 0)
+      continue;
+    const double dx = vel_tot[i][0] - b[i].vel[0];
+    const double dy = vel_tot[i][1] - b[i].vel[1];
+    double& c2      = change2[cell_of[i]];
+    c2              = std::max(c2, dx * dx + dy * dy);
+  }
+
+  for (size_t c = 0; c < asleep.size(); ++c) {
+    if (asleep[c] != 0)
+      continue;
+    quiet[c] = change2[c] < threshold2 ? quiet[c] + 1 : 0;
+    if (quiet[c] >= quiet_frames)
+      asleep[c] = 1;
+  }
+  // le celle attive svegliano le otto vicine
+  for (size_t cy = 0; cy < ny; ++cy) {
+    for (size_t cx = 0; cx < nx; ++cx) {
+      if (change2[cy * nx + cx] < threshold2)
+        continue;
+      for (size_t y = cy > 0 ? cy - 1 : 0; y <= std::min(cy + 1, ny - 1); ++y)
+        for (size_t x = cx > 0 ? cx - 1 : 0; x <= std::min(cx + 1, nx - 1);
+             ++x)
+          wake(y * nx + x);
+    }
+  }
+}
+
+double ActivityTracker::active_fraction() const
+{
+  if (resting.empty())
+    return 1.;
+  return 1.
+       - static_cast<double>(n_resting) / static_cast<double>(resting.size());
+}
+
+size_t ActivityTracker::sleeping_cells() const
+{
+  return static_cast<size_t>(std::count(asleep.begin(), asleep.end(), 1));
+}
+
+} // namespace bd
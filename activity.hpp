@@ -0,0 +1,59 @@
+#ifndef ACTIVITY_HPP
+#define ACTIVITY_HPP
+
+#include "boid.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// attività dello stormo per celle: una cella si addormenta quando la
+// variazione di velocità dei suoi boids resta sotto soglia per quiet_frames
+// frame consecutivi, e i boids di una cella addormentata vengono solo
+// estrapolati; una cella si risveglia quando una cella vicina è attiva,
+// quando vi entra un boid sveglio o con wake_at (mouse, predatori,
+// inserimenti)
+class ActivityTracker
+{
+  double cell = 64.;
+  size_t nx   = 0;
+  size_t ny   = 0;
+  double threshold2 = 1.; // soglia al quadrato sulla variazione di velocità
+  int quiet_frames  = 30;
+
+  std::vector<int> quiet;             // per cella: frame sotto soglia
+  std::vector<unsigned char> asleep;  // per cella
+  std::vector<double> change2;        // per cella: massimo del frame
+  std::vector<size_t> cell_of;        // per boid
+  std::vector<unsigned char> resting; // per boid: stato del frame
+  size_t n_resting = 0;
+
+  size_t cell_index(const Position& p) const;
+  void wake(size_t c);
+
+ public:
+  // griglia sul mondo [0, width) x [0, height); cell va scelta non minore
+  // del raggio d'interazione, così le celle vicine coprono chi può influire
+  void configure(double width, double height, double cell_size,
+                 double threshold, int frames);
+  // tutte le celle sveglie, contatori azzerati
+  void reset();
+  void wake_at(const Position& p, double radius);
+
+  // assegna i boids alle celle e fissa per il frame chi è addormentato
+  void begin_frame(const std::vector<Boid>& b);
+  bool sleeping(size_t i) const
+  {
+    return i < resting.size() && resting[i] != 0;
+  }
+  // vel_tot: velocità dopo le forze, da confrontare con quelle in b
+  void end_frame(const std::vector<Boid>& b,
+                 const std::vector<Velocity>& vel_tot);
+
+  // frazione dei boids aggiornati nell'ultimo frame
+  double active_fraction() const;
+  size_t sleeping_cells() const;
+};
+
+} // namespace bd
+#endif
@@ -0,0 +1,59 @@
+#ifndef BOID_HPP
+#define BOID_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace bd {
+using Position = std::array<double, 2>;
+using Velocity = std::array<double, 2>;
+
+inline void add_inplace(std::array<double, 2>& i,
+                        const std::array<double, 2>& other)
+{
+  i[0] += other[0];
+  i[1] += other[1];
+}
+
+struct Boid
+{
+  Position pos;
+  Velocity vel;
+  double fov     = 0.; // campo visivo in gradi del boid, 0 = quello comune
+  size_t species = 0;  // specie del boid, usata con la matrice di interazione
+  explicit Boid(double x_ = 0, double y_ = 0, double v_x_ = 0, double v_y_ = 0);
+}; // il primo elemento degli array riguarda le coordinate sulle x, il secondo
+   // sulle y
+
+// vero se rel (posizione dell'altro boid relativa a questo) cade nel cono
+// visivo centrato su heading con semiampiezza di coseno cos_half; solo
+// prodotti scalari, senza funzioni trigonometriche
+inline bool in_view(const Velocity& heading, const Position& rel,
+                    double cos_half)
+{
+  const double dot = heading[0] * rel[0] + heading[1] * rel[1];
+  const double lim = cos_half * cos_half
+                   * (heading[0] * heading[0] + heading[1] * heading[1])
+                   * (rel[0] * rel[0] + rel[1] * rel[1]);
+  if (cos_half >= 0.)
+    return dot >= 0. && dot * dot >= lim;
+  return dot >= 0. || dot * dot <= lim;
+}
+
+// somme di posizione e velocità di un gruppo di boids (momenti aggregati)
+struct NeighborSums
+{
+  Position pos_sum{};
+  Velocity vel_sum{};
+  int count = 0;
+};
+
+inline void add_inplace(NeighborSums& i, const NeighborSums& other)
+{
+  add_inplace(i.pos_sum, other.pos_sum);
+  add_inplace(i.vel_sum, other.vel_sum);
+  i.count += other.count;
+}
+
+} // namespace bd
+#endif
@@ -1,7 +1,24 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "boids_logic.hpp"
 #include "doctest.h"
+#include "camera.hpp"
+#include "config.hpp"
+#include "domain.hpp"
+#include "flock_nd.hpp"
+#include "recorder.hpp"
+#include "renderer.hpp"
+#include "scheduler.hpp"
+#include "shm_ring.hpp"
+#include "socket_transport.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
 
 TEST_CASE("add() function")
 {
@@ -199,6 +216,200 @@ TEST_CASE("Test apply_neighbor_rules")
   }
 }
 
+TEST_CASE("Test Barnes-Hut neighbor search")
+{
+  std::mt19937 eng{42};
+  std::uniform_real_distribution<double> x(0., 400.);
+  std::uniform_real_distribution<double> v(-100., 100.);
+  std::vector<bd::Boid> boids;
+  for (int k = 0; k < 300; ++k)
+    boids.emplace_back(x(eng), x(eng), v(eng), v(eng));
+
+  bd::Movement exact(boids, 150., 20., 1.5, 0.04, 0.3);
+  bd::Movement approx(boids, 150., 20., 1.5, 0.04, 0.3);
+
+  SUBCASE("theta = 0 gives the exact result")
+  {
+    approx.set_neighbor_search(bd::NeighborSearch::barnes_hut, 0.);
+    for (size_t i = 0; i < boids.size(); i += 7) {
+      bd::Velocity v1 = boids[i].vel;
+      bd::Velocity v2 = boids[i].vel;
+      exact.apply_neighbor_rules(i, v1);
+      approx.apply_neighbor_rules(i, v2);
+      CHECK(v2[0] == doctest::Approx(v1[0]));
+      CHECK(v2[1] == doctest::Approx(v1[1]));
+    }
+  }
+  SUBCASE("theta > 0 stays close to the exact result")
+  {
+    approx.set_neighbor_search(bd::NeighborSearch::barnes_hut, 0.5);
+    double err = 0.;
+    for (size_t i = 0; i < boids.size(); ++i) {
+      bd::Velocity v1 = boids[i].vel;
+      bd::Velocity v2 = boids[i].vel;
+      exact.apply_neighbor_rules(i, v1);
+      approx.apply_neighbor_rules(i, v2);
+      err += std::hypot(v2[0] - v1[0], v2[1] - v1[1]);
+    }
+    CHECK(err / static_cast<double>(boids.size()) < 2.);
+  }
+}
+
+TEST_CASE("Test Barnes-Hut search on a maximally deep tree")
+{
+  // boids quasi sovrapposti: il quadtree si divide fino a max_depth e la
+  // pila delle visite raggiunge la sua dimensione massima
+  std::vector<bd::Boid> boids;
+  for (int k = 0; k < 200; ++k)
+    boids.emplace_back(500. + 1e-9 * k, 500. + 1e-9 * k, 1., 0.);
+  for (int k = 0; k < 100; ++k)
+    boids.emplace_back(10. * k, 900. - 9. * k, 0., 1.);
+  bd::Movement exact(boids, 150., 20., 1.5, 0.04, 0.3);
+  bd::Movement tree(boids, 150., 20., 1.5, 0.04, 0.3);
+  tree.set_neighbor_search(bd::NeighborSearch::barnes_hut, 0.);
+  for (size_t i = 0; i < boids.size(); i += 5) {
+    bd::Velocity v1 = boids[i].vel;
+    bd::Velocity v2 = boids[i].vel;
+    exact.apply_neighbor_rules(i, v1);
+    tree.apply_neighbor_rules(i, v2);
+    CHECK(v2[0] == doctest::Approx(v1[0]));
+    CHECK(v2[1] == doctest::Approx(v1[1]));
+  }
+}
+
+TEST_CASE("Test grid and prefix-sum neighbor search")
+{
+  std::mt19937 eng{7};
+  std::uniform_real_distribution<double> x(0., 300.);
+  std::uniform_real_distribution<double> v(-100., 100.);
+  std::vector<bd::Boid> boids;
+  for (int k = 0; k < 400; ++k)
+    boids.emplace_back(x(eng), x(eng), v(eng), v(eng));
+
+  bd::Movement exact(boids, 60., 20., 1.5, 0.04, 0.3);
+  bd::Movement other(boids, 60., 20., 1.5, 0.04, 0.3);
+
+  SUBCASE("Exact cell grid")
+  {
+    other.set_neighbor_search(bd::NeighborSearch::grid);
+  }
+  SUBCASE("Summed-area table")
+  {
+    other.set_neighbor_search(bd::NeighborSearch::prefix_sum);
+  }
+  for (size_t i = 0; i < boids.size(); i += 3) {
+    bd::Velocity v1 = boids[i].vel;
+    bd::Velocity v2 = boids[i].vel;
+    exact.apply_neighbor_rules(i, v1);
+    other.apply_neighbor_rules(i, v2);
+    CHECK(v2[0] == doctest::Approx(v1[0]));
+    CHECK(v2[1] == doctest::Approx(v1[1]));
+  }
+}
+
+TEST_CASE("Test field of view")
+{
+  bd::Velocity heading{1., 0.};
+  CHECK(bd::in_view(heading, {10., 0.}, 0.));
+  CHECK(bd::in_view(heading, {10., 9.}, 0.));
+  CHECK_FALSE(bd::in_view(heading, {-10., 0.}, 0.));
+  CHECK(bd::in_view(heading, {-10., 1.}, -1.));
+  CHECK_FALSE(bd::in_view(heading, {-10., 1.}, std::cos(2.5)));
+
+  SUBCASE("A boid ignores the ones behind it")
+  {
+    std::vector<bd::Boid> boids = {bd::Boid(100., 101., 10., 0.),
+                                   bd::Boid(90., 100., 0., 10.)};
+    bd::Movement mov(boids, 100., 20., 1.5, 0.04, 0.3);
+    mov.set_field_of_view(180.);
+    bd::Velocity v = boids[0].vel;
+    mov.apply_neighbor_rules(0, v);
+    CHECK(v[0] == doctest::Approx(10.));
+    CHECK(v[1] == doctest::Approx(0.));
+
+    v = boids[1].vel;
+    mov.apply_neighbor_rules(1, v);
+    // il primo boid è di lato, appena davanti al secondo
+    CHECK(v[0] != doctest::Approx(0.));
+  }
+  SUBCASE("Grid search skips hidden cells with the same result")
+  {
+    std::mt19937 eng{3};
+    std::uniform_real_distribution<double> x(0., 300.);
+    std::uniform_real_distribution<double> v(-100., 100.);
+    std::vector<bd::Boid> boids;
+    for (int k = 0; k < 300; ++k)
+      boids.emplace_back(x(eng), x(eng), v(eng), v(eng));
+    boids[0].fov = 300.; // campo visivo del singolo boid
+
+    bd::Movement exact(boids, 60., 20., 1.5, 0.04, 0.3);
+    bd::Movement grid(boids, 60., 20., 1.5, 0.04, 0.3);
+    exact.set_field_of_view(120.);
+    grid.set_field_of_view(120.);
+    grid.set_neighbor_search(bd::NeighborSearch::grid);
+    for (size_t i = 0; i < boids.size(); i += 3) {
+      bd::Velocity v1 = boids[i].vel;
+      bd::Velocity v2 = boids[i].vel;
+      exact.apply_neighbor_rules(i, v1);
+      grid.apply_neighbor_rules(i, v2);
+      CHECK(v2[0] == doctest::Approx(v1[0]));
+      CHECK(v2[1] == doctest::Approx(v1[1]));
+    }
+  }
+  CHECK_THROWS_AS(bd::Movement{}.set_field_of_view(0.), std::invalid_argument);
+}
+
+TEST_CASE("Test multiple species")
+{
+  // le specie si allineano e si avvicinano solo alla propria, ma si
+  // separano da tutti
+  const std::vector<bd::Interaction> matrix{
+      {1.5, 0.04, 0.3}, {1.5, 0., 0.}, {1.5, 0., 0.}, {1.5, 0.04, 0.3}};
+  bd::Boid b0{100., 100., 10., 0.};
+  bd::Boid b1{150., 100., 0., 10.};
+  bd::Boid b2{105., 100., 0., 0.};
+  b1.species = 1;
+  b2.species = 1;
+
+  bd::Movement mov({b1, b0}, 100., 20., 1.5, 0.04, 0.3);
+  mov.set_species(2, matrix);
+  CHECK(mov.get_boids()[0].species == 0); // boids ordinati per specie
+
+  SUBCASE("No alignment or cohesion across species")
+  {
+    bd::Velocity v = mov.get_boids()[0].vel;
+    mov.apply_neighbor_rules(0, v);
+    CHECK(v[0] == doctest::Approx(10.));
+    CHECK(v[1] == doctest::Approx(0.));
+  }
+  SUBCASE("Separation across species")
+  {
+    mov.push_back_(b2);
+    CHECK(mov.get_boids()[2].species == 1);
+    bd::Velocity v = mov.get_boids()[0].vel;
+    mov.apply_neighbor_rules(0, v);
+    CHECK(v[0] < 10.);
+  }
+  SUBCASE("Same result with the grid search")
+  {
+    mov.push_back_(b2);
+    bd::Velocity v1 = mov.get_boids()[2].vel;
+    mov.apply_neighbor_rules(2, v1);
+    mov.set_neighbor_search(bd::NeighborSearch::grid);
+    bd::Velocity v2 = mov.get_boids()[2].vel;
+    mov.apply_neighbor_rules(2, v2);
+    CHECK(v2[0] == doctest::Approx(v1[0]));
+    CHECK(v2[1] == doctest::Approx(v1[1]));
+  }
+  SUBCASE("Invalid matrix or species")
+  {
+    CHECK_THROWS_AS(mov.set_species(2, {{1., 1., 1.}}), std::invalid_argument);
+    bd::Boid b3{0., 0., 0., 0.};
+    b3.species = 5;
+    CHECK_THROWS_AS(mov.push_back_(b3), std::invalid_argument);
+  }
+}
+
 TEST_CASE("Test apply_mouse_force")
 {
   bd::Boid b{770., 450., 0., 0.};
@@ -230,6 +441,1444 @@ TEST_CASE("Test apply_mouse_force")
   }
 }
 
+TEST_CASE("Test predators")
+{
+  std::mt19937 eng{11};
+  std::uniform_real_distribution<double> x(0., 800.);
+  std::vector<bd::Boid> boids;
+  for (int k = 0; k < 500; ++k)
+    boids.emplace_back(x(eng), x(eng), 0., 0.);
+  bd::Movement mov(boids, 50., 10., 1.5, 0.04, 0.3);
+  mov.add_predator(bd::Boid{400., 400., 0., 0.});
+  mov.add_predator(bd::Boid{10., 790., 0., 0.});
+  mov.build_index();
+
+  SUBCASE("Nearest prey matches a linear scan")
+  {
+    for (const bd::Boid& pr : mov.get_predators()) {
+      size_t best = 0;
+      for (size_t j = 1; j < boids.size(); ++j) {
+        if (mov.diff_pos2(pr.pos, boids[j].pos)
+            < mov.diff_pos2(pr.pos, boids[best].pos))
+          best = j;
+      }
+      CHECK(mov.nearest_prey(pr.pos) == best);
+    }
+  }
+  SUBCASE("Boids flee predators in range")
+  {
+    bd::Boid b{430., 400., 0., 0.};
+    bd::Velocity v = b.vel;
+    mov.apply_predator_force(b, v);
+    CHECK(v[0] > 0.); // si allontana verso destra
+    b = bd::Boid{600., 400., 0., 0.};
+    v = b.vel;
+    mov.apply_predator_force(b, v);
+    CHECK(v[0] == doctest::Approx(0.));
+  }
+  SUBCASE("Predators move towards the nearest prey")
+  {
+    const bd::Position start = mov.get_predators()[0].pos;
+    const size_t prey        = mov.nearest_prey(start);
+    const double before      = mov.diff_pos2(start, boids[prey].pos);
+    mov.update_predators(0.01);
+    CHECK(mov.diff_pos2(mov.get_predators()[0].pos, boids[prey].pos)
+          < before);
+    mov.remove_predator();
+    CHECK(mov.get_predators().size() == 1);
+  }
+  SUBCASE("Removing the last predator leaves no stale index")
+  {
+    mov.update(0, 0.01);
+    mov.remove_predator();
+    mov.remove_predator();
+    REQUIRE(mov.get_predators().empty());
+    bd::Boid b{400., 400., 0., 0.};
+    bd::Velocity v = b.vel;
+    mov.apply_predator_force(b, v);
+    CHECK(v[0] == doctest::Approx(0.));
+    mov.update(1, 0.01);
+    mov.add_predator(bd::Boid{400., 400., 0., 0.});
+    mov.update(2, 0.01);
+    mov.remove_predator();
+    mov.update(3, 0.01);
+    CHECK(mov.get_boids().size() == boids.size());
+  }
+}
+
+TEST_CASE("Test obstacle field")
+{
+  bd::ObstacleField field;
+  field.add_circle({200., 200.}, 50.);
+  field.add_polygon({{400., 100.}, {500., 100.}, {500., 200.}, {400., 200.}});
+  field.add_wall({100., 500.}, {300., 500.});
+
+  CHECK(field.exact_distance({200., 200.}) == doctest::Approx(-50.));
+  CHECK(field.exact_distance({450., 150.}) == doctest::Approx(-50.));
+  CHECK(field.exact_distance({200., 520.}) == doctest::Approx(20.));
+
+  field.bake(800., 600., 2., 80.);
+  SUBCASE("Sampled distance and gradient")
+  {
+    bd::Velocity grad;
+    double dist = field.sample({270., 200.}, grad);
+    CHECK(dist == doctest::Approx(20.).epsilon(0.02));
+    CHECK(grad[0] == doctest::Approx(1.).epsilon(0.05));
+    dist = field.sample({200., 490.}, grad);
+    CHECK(dist == doctest::Approx(10.).epsilon(0.02));
+    CHECK(grad[1] < 0.);
+    CHECK(field.sample({700., 500.}, grad) == doctest::Approx(80.));
+  }
+  SUBCASE("Boids steer away from obstacles")
+  {
+    bd::Movement mov{};
+    mov.set_obstacles(field);
+    bd::Boid b{270., 200., 0., 0.};
+    bd::Velocity v = b.vel;
+    mov.apply_obstacle_force(b, v);
+    CHECK(v[0] > 0.);
+    b = bd::Boid{700., 500., 0., 0.};
+    v = b.vel;
+    mov.apply_obstacle_force(b, v);
+    CHECK(v[0] == doctest::Approx(0.));
+  }
+}
+
+TEST_CASE("Test force field emitters")
+{
+  bd::Emitter point;
+  point.a = {100., 100.};
+  bd::Emitter line;
+  line.shape    = bd::Emitter::Shape::line;
+  line.a        = {300., 100.};
+  line.b        = {300., 500.};
+  line.strength = -40.;
+  line.falloff  = bd::Emitter::Falloff::linear;
+  bd::Emitter region;
+  region.shape   = bd::Emitter::Shape::region;
+  region.a       = {600., 600.};
+  region.b       = {700., 700.};
+  region.radius  = 20.;
+  region.falloff = bd::Emitter::Falloff::quadratic;
+
+  SUBCASE("Single emitters")
+  {
+    auto f = bd::emitter_force(point, {150., 100.});
+    CHECK(f[0] == doctest::Approx(-40.));
+    f = bd::emitter_force(point, {200., 100.});
+    CHECK(f[0] == doctest::Approx(0.));
+    f = bd::emitter_force(line, {280., 300.});
+    CHECK(f[0] == doctest::Approx(-30.).epsilon(0.01)); // respinto a sx
+    CHECK(f[1] == doctest::Approx(0.));
+    f = bd::emitter_force(region, {650., 590.});
+    CHECK(f[1] == doctest::Approx(10.).epsilon(0.01));
+  }
+  SUBCASE("Binned field only evaluates nearby emitters")
+  {
+    bd::ForceField field;
+    field.add(point);
+    field.add(line);
+    field.add(region);
+    bd::Movement mov{};
+    mov.set_force_field(field);
+    const auto& binned = mov.get_force_field();
+    CHECK(binned.candidates({1500., 100.}) == 0);
+    CHECK(binned.candidates({650., 650.}) == 1);
+
+    bd::Boid b{280., 300., 0., 0.};
+    bd::Velocity v = b.vel;
+    mov.apply_field_force(b, v);
+    auto f = bd::emitter_force(line, b.pos);
+    CHECK(v[0] == doctest::Approx(f[0]));
+  }
+  SUBCASE("Swapped region corners are reordered")
+  {
+    bd::Emitter swapped = region;
+    swapped.a           = {700., 600.};
+    swapped.b           = {600., 700.};
+    bd::ForceField field;
+    field.add(point);
+    field.set(field.add(region), swapped);
+    swapped.a = {700., 700.};
+    swapped.b = {600., 600.};
+    field.add(swapped);
+    for (size_t k = 1; k < 3; ++k) {
+      CHECK(field.get_emitters()[k].a == region.a);
+      CHECK(field.get_emitters()[k].b == region.b);
+    }
+    bd::Movement mov({bd::Boid(650., 590., 0., 0.)}, 40., 10., 0., 0., 0.);
+    mov.set_force_field(field);
+    mov.update(0, 1. / 60.);
+    CHECK(mov.get_boids()[0].vel[1] > 0.);
+    bd::Emitter bad;
+    bad.radius = 0.;
+    CHECK_THROWS_AS(field.set(0, bad), std::invalid_argument);
+  }
+}
+
+TEST_CASE("Test dimension-templated flock")
+{
+  SUBCASE("2D instantiation matches Movement")
+  {
+    std::mt19937 eng{5};
+    std::uniform_real_distribution<double> x(0., 300.);
+    std::uniform_real_distribution<double> v(-100., 100.);
+    std::vector<bd::Boid> boids;
+    std::vector<bd::BasicBoid<2>> boids2;
+    for (int k = 0; k < 200; ++k) {
+      boids.emplace_back(x(eng), x(eng), v(eng), v(eng));
+      boids2.push_back({boids.back().pos, boids.back().vel});
+    }
+    bd::Movement mov(boids, 50., 20., 1.5, 0.04, 0.3);
+    bd::BasicMovement<2> mov2(boids2, {1600., 900.}, 50., 20., 1.5, 0.04, 0.3);
+    mov2.build_index();
+    for (size_t i = 0; i < boids.size(); i += 5) {
+      bd::Velocity v1 = boids[i].vel;
+      bd::VecN<2> v2  = boids2[i].vel;
+      mov.apply_neighbor_rules(i, v1);
+      mov2.apply_neighbor_rules(i, v2);
+      CHECK(v2[0] == doctest::Approx(v1[0]));
+      CHECK(v2[1] == doctest::Approx(v1[1]));
+    }
+    // regole e limite di velocità sono gli stessi, bit per bit
+    CHECK(mov.rule1(boids[0].pos, {boids[0].pos[0] + 3., boids[0].pos[1]})
+          == mov2.rule1(boids2[0].pos,
+                        {boids2[0].pos[0] + 3., boids2[0].pos[1]}));
+    CHECK(mov.rule2(boids[0].vel, boids[1].vel)
+          == mov2.rule2(boids2[0].vel, boids2[1].vel));
+    CHECK(mov.rule3(boids[0].pos, boids[1].pos)
+          == mov2.rule3(boids2[0].pos, boids2[1].pos));
+    bd::Velocity fast{900., 400.};
+    bd::VecN<2> fast2 = fast;
+    mov.limit_velocity(fast);
+    mov2.limit_velocity(fast2);
+    CHECK(fast == fast2);
+  }
+  SUBCASE("3D grid search matches the brute-force search")
+  {
+    std::mt19937 eng{9};
+    std::uniform_real_distribution<double> x(0., 200.);
+    std::uniform_real_distribution<double> v(-100., 100.);
+    std::vector<bd::Boid3> boids;
+    for (int k = 0; k < 300; ++k)
+      boids.push_back({{x(eng), x(eng), x(eng)}, {v(eng), v(eng), v(eng)}});
+    bd::Movement3 brute(boids, {200., 200., 200.}, 40., 10., 1.5, 0.04, 0.3);
+    bd::Movement3 grid(boids, {200., 200., 200.}, 40., 10., 1.5, 0.04, 0.3);
+    grid.build_index();
+    for (size_t i = 0; i < boids.size(); i += 3) {
+      bd::VecN<3> v1 = boids[i].vel;
+      bd::VecN<3> v2 = boids[i].vel;
+      brute.apply_neighbor_rules(i, v1);
+      grid.apply_neighbor_rules(i, v2);
+      for (size_t k = 0; k < 3; ++k)
+        CHECK(v2[k] == doctest::Approx(v1[k]));
+    }
+  }
+  SUBCASE("3D update wraps on every axis and limits speed")
+  {
+    bd::Movement3 mov({{{5., 5., 1.}, {0., 0., -900.}}}, {100., 100., 100.},
+                      10., 2., 1.5, 0.04, 0.3);
+    mov.update(0.01);
+    const bd::Boid3& b = mov.get_boids()[0];
+    CHECK(b.pos[2] > 90.);
+    CHECK(std::sqrt(bd::Movement3::norm2(b.vel))
+          <= bd::Movement3::max_speed + 1e-6);
+  }
+}
+
+TEST_CASE("Test fixed-point backend")
+{
+  SUBCASE("Q.16 arithmetic and integer square root")
+  {
+    const bd::Fixed x(2.5);
+    const bd::Fixed y(-0.75);
+    CHECK(static_cast<double>(x + y) == doctest::Approx(1.75));
+    CHECK(static_cast<double>(x * y) == doctest::Approx(-1.875));
+    CHECK(static_cast<double>(x / y) == doctest::Approx(-3.3333).epsilon(1e-4));
+    CHECK(static_cast<double>(x / 2) == doctest::Approx(1.25));
+    CHECK(y < x);
+    CHECK(bd::isqrt(99) == 9);
+    CHECK(bd::isqrt(uint64_t{1} << 40) == uint64_t{1} << 20);
+    CHECK(static_cast<double>(sqrt(bd::Fixed(490000)))
+          == doctest::Approx(700.));
+  }
+  SUBCASE("fixed-point run follows the double run and is reproducible")
+  {
+    std::mt19937 eng{21};
+    std::uniform_real_distribution<double> x(0., 300.);
+    std::uniform_real_distribution<double> v(-100., 100.);
+    std::vector<bd::BasicBoid<2>> boids;
+    std::vector<bd::FixedBoid> fixed;
+    for (int k = 0; k < 100; ++k) {
+      boids.push_back({{x(eng), x(eng)}, {v(eng), v(eng)}});
+      const auto& b = boids.back();
+      fixed.push_back({{bd::Fixed(b.pos[0]), bd::Fixed(b.pos[1])},
+                       {bd::Fixed(b.vel[0]), bd::Fixed(b.vel[1])}});
+    }
+    auto make_fixed = [&fixed]() {
+      return bd::FixedMovement(fixed, {bd::Fixed(300), bd::Fixed(300)},
+                               bd::Fixed(50), bd::Fixed(20), bd::Fixed(1.5),
+                               bd::Fixed(0.04), bd::Fixed(0.3));
+    };
+    bd::BasicMovement<2> mov(boids, {300., 300.}, 50., 20., 1.5, 0.04, 0.3);
+    bd::FixedMovement fix_1 = make_fixed();
+    bd::FixedMovement fix_2 = make_fixed();
+    for (int step = 0; step < 5; ++step) {
+      mov.update(1. / 64.);
+      fix_1.update(bd::Fixed(1. / 64.));
+      fix_2.update(bd::Fixed(1. / 64.));
+    }
+    for (size_t i = 0; i < boids.size(); ++i) {
+      const bd::FixedBoid& f = fix_1.get_boids()[i];
+      for (size_t k = 0; k < 2; ++k) {
+        CHECK(f.pos[k].get_raw() == fix_2.get_boids()[i].pos[k].get_raw());
+        CHECK(static_cast<double>(f.pos[k])
+              == doctest::Approx(mov.get_boids()[i].pos[k]).epsilon(0.01));
+      }
+    }
+    CHECK(bd::state_hash(fix_1.get_boids())
+          == bd::state_hash(fix_2.get_boids()));
+    fix_2.update(bd::Fixed(1. / 64.));
+    CHECK(bd::state_hash(fix_1.get_boids())
+          != bd::state_hash(fix_2.get_boids()));
+  }
+  SUBCASE("the fixed-point run is a headless base-model option")
+  {
+    bd::SimConfig cfg;
+    bd::set_option(cfg, "flock.fixed_point", "true");
+    CHECK_THROWS_AS(bd::validate(cfg), std::invalid_argument);
+    cfg.headless = true;
+    CHECK_NOTHROW(bd::validate(cfg));
+    bd::set_option(cfg, "motion.integrator", "rk2");
+    CHECK_THROWS_AS(bd::validate(cfg), std::invalid_argument);
+  }
+}
+
+// stormo casuale sull'intera finestra, con un boid che attraversa il bordo
+// destro del mondo
+static std::vector<bd::Boid> random_flock(unsigned seed)
+{
+  std::mt19937 eng{seed};
+  std::uniform_real_distribution<double> x(0., 1600.);
+  std::uniform_real_distribution<double> y(0., 900.);
+  std::uniform_real_distribution<double> v(-300., 300.);
+  std::vector<bd::Boid> boids;
+  for (int k = 0; k < 300; ++k)
+    boids.emplace_back(x(eng), y(eng), v(eng), v(eng));
+  boids.emplace_back(1599., 450., 600., 0.);
+  return boids;
+}
+
+// confronta i boids di una simulazione distribuita con frames passi seriali
+// delle sole regole del moto (d = 60, d_s = 20, s = 1.5, a = 0.04, c = 0.3)
+static void check_matches_serial(const std::vector<bd::Boid>& boids,
+                                 const std::vector<bd::Boid>& res, int frames,
+                                 double dt,
+                                 const bd::Position& world = {1600., 900.})
+{
+  bd::Movement mov(boids, 60., 20., 1.5, 0.04, 0.3, world);
+  mov.set_neighbor_search(bd::NeighborSearch::grid);
+  for (int f = 0; f < frames; ++f) {
+    mov.build_index();
+    std::vector<bd::Velocity> vel_tot;
+    for (size_t i = 0; i < boids.size(); ++i) {
+      vel_tot.push_back(mov.get_boids()[i].vel);
+      mov.apply_neighbor_rules(i, vel_tot[i]);
+      mov.limit_velocity(vel_tot[i]);
+    }
+    mov.update_pos_vel(vel_tot, dt);
+  }
+  REQUIRE(res.size() == boids.size());
+  for (const bd::Boid& b : res) {
+    double best = 1e9;
+    for (const bd::Boid& o : mov.get_boids())
+      best = std::min(best, mov.diff_pos2(b.pos, o.pos));
+    CHECK(best < 1e-12);
+  }
+}
+
+TEST_CASE("Test shared-memory domain decomposition")
+{
+  SUBCASE("strip partition and ring buffer")
+  {
+    const bd::StripPartition part(4, 1600.);
+    CHECK(part.owner(0.) == 0);
+    CHECK(part.owner(399.9) == 0);
+    CHECK(part.owner(400.) == 1);
+    CHECK(part.owner(1599.9) == 3);
+    CHECK(part.left(0) == 3);
+    CHECK(part.right(3) == 0);
+
+    bd::ShmRing ring(3);
+    CHECK(ring.capacity() == 4);
+    for (int k = 0; k < 4; ++k)
+      ring.push({bd::Boid{static_cast<double>(k)}, k == 3});
+    CHECK(ring.pop().boid.pos[0] == 0.);
+    ring.push({bd::Boid{4.}, false});
+    for (int k = 1; k < 3; ++k)
+      CHECK(ring.pop().boid.pos[0] == static_cast<double>(k));
+    CHECK(ring.pop().last);
+    CHECK(ring.pop().boid.pos[0] == 4.);
+    ring.close();
+    CHECK_THROWS_AS(ring.pop(), std::runtime_error);
+  }
+  SUBCASE("worker processes match the serial update")
+  {
+    const std::vector<bd::Boid> boids = random_flock(17);
+
+    const double dt = 1. / 60.;
+    check_matches_serial(
+        boids,
+        bd::run_shared_memory(boids, 4, 5, dt, 60., 20., 1.5, 0.04, 0.3,
+                              {1600., 900.}),
+        5, dt);
+  }
+  SUBCASE("strips follow a world wider than the window")
+  {
+    // lo stesso stormo steso su un mondo largo il doppio
+    std::vector<bd::Boid> boids = random_flock(19);
+    for (bd::Boid& b : boids)
+      b.pos[0] *= 2.;
+    boids.back().pos[0] = 3199.;
+    const double dt     = 1. / 60.;
+    check_matches_serial(boids,
+                         bd::run_shared_memory(boids, 4, 5, dt, 60., 20., 1.5,
+                                               0.04, 0.3, {3200., 900.}),
+                         5, dt, {3200., 900.});
+  }
+  SUBCASE("strips narrower than d are rejected")
+  {
+    CHECK_THROWS_AS(bd::run_shared_memory({}, 40, 1, 0.01, 60., 20., 1.5,
+                                          0.04, 0.3, {1600., 900.}),
+                    std::invalid_argument);
+  }
+}
+
+TEST_CASE("Test socket domain decomposition")
+{
+  SUBCASE("boid blocks compress without loss")
+  {
+    std::vector<bd::Boid> block = random_flock(3);
+    block[5].species = 2;
+    block[6].fov     = 120.;
+    const std::vector<std::uint8_t> data = bd::encode_boids(block);
+    CHECK(data.size() < block.size() * 6 * 8);
+    const std::vector<bd::Boid> back = bd::decode_boids(data);
+    REQUIRE(back.size() == block.size());
+    for (size_t i = 0; i < block.size(); ++i) {
+      CHECK(back[i].pos == block[i].pos);
+      CHECK(back[i].vel == block[i].vel);
+      CHECK(back[i].fov == block[i].fov);
+      CHECK(back[i].species == block[i].species);
+    }
+    std::vector<std::uint8_t> cut(data.begin(), data.end() - 1);
+    CHECK_THROWS_AS(bd::decode_boids(cut), std::runtime_error);
+  }
+  SUBCASE("workers on Unix sockets and loopback TCP match the serial update")
+  {
+    const std::vector<bd::Boid> boids = random_flock(23);
+    const double dt                   = 1. / 60.;
+    for (const bd::Transport t :
+         {bd::Transport::unix_socket, bd::Transport::tcp}) {
+      check_matches_serial(boids,
+                           bd::run_sockets(boids, 3, t, 5, dt, 60., 20., 1.5,
+                                           0.04, 0.3, {1600., 900.}),
+                           5, dt);
+    }
+    std::vector<bd::Boid> wide = random_flock(29);
+    for (bd::Boid& b : wide)
+      b.pos[0] *= 2.;
+    check_matches_serial(wide,
+                         bd::run_sockets(wide, 3, bd::Transport::unix_socket,
+                                         5, dt, 60., 20., 1.5, 0.04, 0.3,
+                                         {3200., 900.}),
+                         5, dt, {3200., 900.});
+  }
+  SUBCASE("blocks larger than the flock are rejected")
+  {
+    const std::array<int, 2> fds =
+        bd::connected_pair(bd::Transport::unix_socket);
+    bd::SocketChannel a(fds[0], 300);
+    bd::SocketChannel b(fds[1], 10);
+    const std::vector<bd::Boid> block = random_flock(31);
+    a.send({block.begin(), block.begin() + 10});
+    std::vector<bd::Boid> got;
+    b.receive(got);
+    CHECK(got.size() == 10);
+    a.send(block);
+    CHECK_THROWS_AS(b.receive(got), std::runtime_error);
+    CHECK(bd::max_encoded_size(2) == 2 * 6 * 9);
+  }
+}
+
+TEST_CASE("Test load balancing of the threaded update")
+{
+  SUBCASE("ORB splits a clustered flock into equal parts")
+  {
+    std::mt19937 eng{8};
+    std::normal_distribution<double> x(400., 40.);
+    std::normal_distribution<double> y(300., 40.);
+    std::vector<bd::Boid> boids;
+    for (int k = 0; k < 400; ++k)
+      boids.emplace_back(x(eng), y(eng));
+    bd::OrbPartition part;
+    part.build(boids, {}, 4, {0., 0.}, {1600., 900.});
+    std::vector<int> count(4, 0);
+    for (const bd::Boid& b : boids)
+      ++count[part.owner(b.pos)];
+    for (const int n : count)
+      CHECK(n == 100);
+  }
+  SUBCASE("the balancer moves work away from the slow part")
+  {
+    const std::vector<bd::Boid> boids = random_flock(4);
+    auto run = [&boids](double migration_cost, size_t& first_part) {
+      bd::LoadBalancer lb({1600., 900.}, 2, 1, migration_cost);
+      lb.reset(boids);
+      std::vector<size_t> n(2, 0);
+      for (const bd::Boid& b : boids)
+        ++n[lb.partition().owner(b.pos)];
+      lb.record(0, n[0], 3.);
+      lb.record(1, n[1], 1.);
+      const bool changed = lb.end_frame(boids);
+      CHECK(lb.imbalance() == doctest::Approx(1.5));
+      first_part = 0;
+      for (const bd::Boid& b : boids)
+        first_part += lb.partition().owner(b.pos) == 0 ? 1u : 0u;
+      return changed;
+    };
+    size_t first = 0;
+    CHECK(run(1., first));
+    CHECK(first < boids.size() / 2);
+    // se spostare i boids costa troppo la partizione resta uguale
+    CHECK_FALSE(run(20., first));
+    CHECK(first == boids.size() / 2);
+  }
+  SUBCASE("threaded update matches the serial update")
+  {
+    const std::vector<bd::Boid> boids = random_flock(6);
+    bd::Movement serial(boids, 60., 20., 1.5, 0.04, 0.3);
+    bd::Movement threaded(boids, 60., 20., 1.5, 0.04, 0.3);
+    serial.set_neighbor_search(bd::NeighborSearch::grid);
+    threaded.set_neighbor_search(bd::NeighborSearch::grid);
+    threaded.set_threads(3, 2);
+    CHECK_THROWS_AS(threaded.set_threads(0), std::invalid_argument);
+    for (int f = 0; f < 6; ++f) {
+      serial.update(f, 1. / 60.);
+      threaded.update(f, 1. / 60.);
+    }
+    for (size_t i = 0; i < boids.size(); ++i) {
+      CHECK(threaded.get_boids()[i].pos == serial.get_boids()[i].pos);
+      CHECK(threaded.get_boids()[i].vel == serial.get_boids()[i].vel);
+    }
+  }
+}
+
+TEST_CASE("Test work-stealing scheduler")
+{
+  SUBCASE("Chase-Lev deque order")
+  {
+    bd::WorkStealingDeque<size_t> dq;
+    dq.reserve(3);
+    for (size_t k = 0; k < 4; ++k)
+      CHECK(dq.push(k));
+    CHECK_FALSE(dq.push(4));
+    CHECK(dq.steal() == 0u);
+    CHECK(dq.pop() == 3u);
+    CHECK(dq.pop() == 2u);
+    CHECK(dq.steal() == 1u);
+    CHECK_FALSE(dq.pop().has_value());
+    CHECK_FALSE(dq.steal().has_value());
+  }
+  SUBCASE("every task runs once, even with unbalanced work")
+  {
+    bd::TaskScheduler sched(4);
+    std::vector<std::atomic<int>> hits(500);
+    for (int round = 0; round < 3; ++round) {
+      sched.parallel_for(hits.size(), [&hits](size_t k) {
+        // i primi compiti sono molto più lunghi degli altri
+        volatile double x = 0.;
+        for (size_t j = 0; j < (k < 20 ? 20000u : 10u); ++j)
+          x = x + 1.;
+        ++hits[k];
+      });
+    }
+    for (const std::atomic<int>& h : hits)
+      CHECK(h.load() == 3);
+    CHECK_THROWS_AS(sched.parallel_for(10,
+                                       [](size_t k) {
+                                         if (k == 7)
+                                           throw std::runtime_error("x");
+                                       }),
+                    std::runtime_error);
+  }
+  SUBCASE("work-stealing update matches the serial update")
+  {
+    std::vector<bd::Boid> boids = random_flock(12);
+    // quasi tutto lo stormo in un solo blocco di celle
+    std::mt19937 eng{2};
+    std::uniform_real_distribution<double> x(10., 100.);
+    for (int k = 0; k < 600; ++k)
+      boids.emplace_back(x(eng), x(eng), 50., -20.);
+    bd::Movement serial(boids, 60., 20., 1.5, 0.04, 0.3);
+    bd::Movement stealing(boids, 60., 20., 1.5, 0.04, 0.3);
+    serial.set_neighbor_search(bd::NeighborSearch::grid);
+    stealing.set_neighbor_search(bd::NeighborSearch::grid);
+    stealing.set_threads(4);
+    stealing.set_work_stealing(true);
+    for (int f = 0; f < 4; ++f) {
+      serial.update(f, 1. / 60.);
+      stealing.update(f, 1. / 60.);
+    }
+    for (size_t i = 0; i < boids.size(); ++i) {
+      CHECK(stealing.get_boids()[i].pos == serial.get_boids()[i].pos);
+      CHECK(stealing.get_boids()[i].vel == serial.get_boids()[i].vel);
+    }
+  }
+}
+
+TEST_CASE("Test async stats pipeline")
+{
+  SUBCASE("stats of a small flock")
+  {
+    const std::vector<bd::Boid> boids = {bd::Boid(0., 0., 3., 4.),
+                                         bd::Boid(6., 8., 0., 0.),
+                                         bd::Boid(0., 8., 0., 10.)};
+    const bd::FlockStats st = bd::compute_stats(7, boids);
+    CHECK(st.frame == 7);
+    CHECK(st.n_boids == 3);
+    CHECK(st.mean_speed == doctest::Approx(5.));
+    CHECK(st.speed_std_dev == doctest::Approx(std::sqrt(50. / 3.)));
+    CHECK(st.mean_distance == doctest::Approx(8.));
+    CHECK(st.dist_std_dev == doctest::Approx(std::sqrt(8. / 3.)));
+  }
+  SUBCASE("the worker publishes results without blocking the caller")
+  {
+    bd::SpscQueue<int> q(2);
+    int x = 1;
+    CHECK(q.try_push(x));
+    CHECK(q.try_push(x));
+    CHECK_FALSE(q.try_push(x));
+    CHECK(q.try_pop() == 1);
+
+    bd::StatsWorker worker(nullptr);
+    CHECK(worker.submit(3, random_flock(1)));
+    std::optional<bd::FlockStats> st;
+    for (int k = 0; k < 2000 && !st; ++k) {
+      st = worker.poll();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(st.has_value());
+    CHECK(st->frame == 3);
+    CHECK(st->n_boids == 301);
+  }
+  SUBCASE("the stats interval is a runtime setting")
+  {
+    bd::Movement mov(random_flock(2), 60., 20., 1.5, 0.04, 0.3);
+    CHECK_THROWS_AS(mov.set_stats_interval(-1.), std::invalid_argument);
+    mov.set_stats_interval(0.);
+    mov.update(0, 1.);
+    CHECK_FALSE(mov.poll_stats().has_value());
+    mov.set_stats_interval(0.5);
+    CHECK(mov.get_stats_interval() == 0.5);
+  }
+}
+
+TEST_CASE("Test pairwise distance estimator")
+{
+  SUBCASE("small flocks fall back to the exact computation")
+  {
+    const std::vector<bd::Boid> boids = {bd::Boid(0., 0., 3., 4.),
+                                         bd::Boid(6., 8., 0., 0.),
+                                         bd::Boid(0., 8., 0., 10.)};
+    const bd::FlockStats st = bd::estimate_stats(7, boids, 0.01);
+    CHECK(st.dist_error == 0.);
+    CHECK(st.mean_distance == doctest::Approx(8.));
+    CHECK(st.mean_speed == doctest::Approx(5.));
+    CHECK_THROWS_AS(bd::estimate_stats(0, boids, 0.), std::invalid_argument);
+    CHECK_THROWS_AS(bd::estimate_stats(0, boids, 0.1, 1.),
+                    std::invalid_argument);
+  }
+  SUBCASE("the estimate stays within the requested error")
+  {
+    // metà uniforme sullo schermo, metà in un gruppo compatto
+    std::vector<bd::Boid> boids = random_flock(31);
+    std::mt19937 eng{31};
+    std::normal_distribution<double> clump(400., 30.);
+    std::uniform_real_distribution<double> x(0., 1600.);
+    std::uniform_real_distribution<double> y(0., 900.);
+    for (int k = 0; k < 2500; ++k) {
+      boids.emplace_back(clump(eng), clump(eng), 10., 0.);
+      boids.emplace_back(x(eng), y(eng), 0., 10.);
+    }
+    const bd::FlockStats exact = bd::compute_stats(0, boids);
+    for (std::uint64_t seed = 0; seed < 3; ++seed) {
+      const bd::FlockStats st = bd::estimate_stats(0, boids, 0.02, 0.95, seed);
+      CHECK(st.dist_error > 0.);
+      CHECK(st.dist_error <= 0.02 * exact.mean_distance);
+      CHECK(std::abs(st.mean_distance - exact.mean_distance)
+            <= 0.02 * exact.mean_distance);
+      CHECK(st.dist_std_dev
+            == doctest::Approx(exact.dist_std_dev).epsilon(0.05));
+      CHECK(st.mean_speed == doctest::Approx(exact.mean_speed));
+    }
+  }
+}
+
+TEST_CASE("Test flock metrics")
+{
+  SUBCASE("power-of-two histogram bins")
+  {
+    CHECK(bd::histogram_bin(0) == 0);
+    CHECK(bd::histogram_bin(1) == 1);
+    CHECK(bd::histogram_bin(3) == 2);
+    CHECK(bd::histogram_bin(4) == 3);
+  }
+  SUBCASE("two separated clumps are two clusters")
+  {
+    std::vector<bd::Boid> boids;
+    for (int k = 0; k < 10; ++k) {
+      boids.emplace_back(200. + 3. * k, 200., 50., 0.);
+      boids.emplace_back(1000. + 3. * k, 600., 50., 0.);
+    }
+    bd::Movement mov(boids, 60., 20., 1.5, 0.04, 0.3);
+    mov.set_stats_interval(0.01);
+    mov.update(0, 1. / 60.);
+    const std::optional<bd::FlockMetrics>& m = mov.get_flock_metrics();
+    REQUIRE(m.has_value());
+    CHECK(m->n_clusters == 2);
+    CHECK(m->largest_cluster == 10);
+    CHECK(m->cluster_sizes.size() == 5);
+    CHECK(m->cluster_sizes[4] == 2);
+    REQUIRE(m->density.size() == 5);
+    CHECK(m->density[4] == 20); // 9 vicini ciascuno
+    CHECK(m->polarization == doctest::Approx(1.));
+  }
+  SUBCASE("every neighbor search finds the same clusters")
+  {
+    const std::vector<bd::Boid> boids = random_flock(21);
+    bd::Movement ref(boids, 40., 20., 1.5, 0.04, 0.3);
+    ref.set_neighbor_search(bd::NeighborSearch::brute_force);
+    ref.set_stats_interval(0.01);
+    ref.update(0, 1. / 60.);
+    REQUIRE(ref.get_flock_metrics().has_value());
+    const bd::FlockMetrics& r = *ref.get_flock_metrics();
+    CHECK(r.n_clusters > 1);
+
+    for (auto mode : {bd::NeighborSearch::grid, bd::NeighborSearch::barnes_hut,
+                      bd::NeighborSearch::prefix_sum}) {
+      bd::Movement mov(boids, 40., 20., 1.5, 0.04, 0.3);
+      mov.set_neighbor_search(mode);
+      mov.set_threads(4);
+      mov.set_stats_interval(0.01);
+      mov.update(0, 1. / 60.);
+      REQUIRE(mov.get_flock_metrics().has_value());
+      CHECK(mov.get_flock_metrics()->n_clusters == r.n_clusters);
+      CHECK(mov.get_flock_metrics()->largest_cluster == r.largest_cluster);
+      CHECK(mov.get_flock_metrics()->cluster_sizes == r.cluster_sizes);
+    }
+  }
+  SUBCASE("pairs without forces still count for every search")
+  {
+    const std::vector<bd::Boid> boids = random_flock(24);
+    std::vector<bd::FlockMetrics> found;
+    for (auto mode : {bd::NeighborSearch::brute_force, bd::NeighborSearch::grid,
+                      bd::NeighborSearch::barnes_hut,
+                      bd::NeighborSearch::prefix_sum}) {
+      bd::Movement mov(boids, 40., 20., 0., 0., 0.);
+      mov.set_neighbor_search(mode);
+      mov.set_stats_interval(0.01);
+      mov.update(0, 1. / 60.);
+      REQUIRE(mov.get_flock_metrics().has_value());
+      found.push_back(*mov.get_flock_metrics());
+    }
+    CHECK(found[0].n_clusters < boids.size());
+    for (size_t k = 1; k < found.size(); ++k) {
+      CHECK(found[k].n_clusters == found[0].n_clusters);
+      CHECK(found[k].cluster_sizes == found[0].cluster_sizes);
+      CHECK(found[k].density == found[0].density);
+    }
+  }
+  SUBCASE("the published stats carry the metrics of their frame")
+  {
+    for (bool substeps : {false, true}) {
+      bd::Movement mov(random_flock(23), 40., 20., 1.5, 0.04, 0.3);
+      mov.set_substepping(substeps, 0.05);
+      mov.set_stats_interval(0.01);
+      mov.update(0, 1. / 60.);
+      std::optional<bd::FlockStats> st;
+      for (int k = 0; k < 2000 && !st; ++k) {
+        st = mov.poll_stats();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      REQUIRE(st.has_value());
+      REQUIRE(st->metrics.has_value());
+      REQUIRE(mov.get_flock_metrics().has_value());
+      const bd::FlockMetrics& m = *mov.get_flock_metrics();
+      CHECK(st->metrics->n_clusters == m.n_clusters);
+      CHECK(st->metrics->largest_cluster == m.largest_cluster);
+      CHECK(st->metrics->cluster_sizes == m.cluster_sizes);
+      CHECK(st->metrics->density == m.density);
+      CHECK(st->metrics->polarization == m.polarization);
+    }
+  }
+  SUBCASE("metrics are skipped when disabled or between stats frames")
+  {
+    bd::Movement mov(random_flock(22), 40., 20., 1.5, 0.04, 0.3);
+    mov.set_stats_interval(1.);
+    mov.update(0, 1. / 60.);
+    CHECK_FALSE(mov.get_flock_metrics().has_value());
+    mov.set_flock_metrics(false);
+    mov.update(1, 1.);
+    CHECK_FALSE(mov.get_flock_metrics().has_value());
+  }
+}
+
+TEST_CASE("Test boundary policies")
+{
+  const bd::Arena arena{100., 50., 10., 20.};
+  SUBCASE("periodic wraps, reflective bounces")
+  {
+    bd::Position p{105., -2.};
+    bd::Velocity v{30., -5.};
+    bd::PeriodicBoundary::confine(p, v, arena);
+    CHECK(p[0] == doctest::Approx(5.));
+    CHECK(p[1] == doctest::Approx(48.));
+    CHECK(v[0] == 30.);
+
+    p = {105., -2.};
+    bd::ReflectiveBoundary::confine(p, v, arena);
+    CHECK(p[0] == doctest::Approx(95.));
+    CHECK(p[1] == doctest::Approx(2.));
+    CHECK(v[0] == -30.);
+    CHECK(v[1] == 5.);
+  }
+  SUBCASE("soft margin pushes only inside the band")
+  {
+    bd::Velocity v{0., 0.};
+    bd::SoftMarginBoundary::steer({50., 25.}, v, arena);
+    CHECK(v == bd::Velocity{0., 0.});
+    bd::SoftMarginBoundary::steer({5., 45.}, v, arena);
+    CHECK(v[0] == doctest::Approx(10.));
+    CHECK(v[1] == doctest::Approx(-10.));
+  }
+  SUBCASE("bounded arenas keep the flock inside")
+  {
+    for (auto mode : {bd::Boundary::reflective, bd::Boundary::soft_margin}) {
+      bd::Movement mov(random_flock(41), 60., 20., 1.5, 0.04, 0.3);
+      mov.set_stats_interval(0.);
+      mov.set_boundary(mode);
+      CHECK(mov.get_boundary() == mode);
+      mov.add_predator(bd::Boid(1590., 10., 400., -400.));
+      for (int f = 0; f < 120; ++f)
+        mov.update(f, 1. / 30.);
+      for (const bd::Boid& b : mov.get_boids()) {
+        CHECK(b.pos[0] >= 0.);
+        CHECK(b.pos[0] < bd::Movement::screen_width);
+        CHECK(b.pos[1] >= 0.);
+        CHECK(b.pos[1] < bd::Movement::screen_height);
+      }
+    }
+    bd::Movement mov;
+    CHECK_THROWS_AS(mov.set_boundary(bd::Boundary::soft_margin, 0.),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(mov.set_boundary(bd::Boundary::soft_margin, 500.),
+                    std::invalid_argument);
+  }
+}
+
+TEST_CASE("Test adaptive substepping")
+{
+  // due boids veloci che si incrociano: con un solo passo saltano da 25 a
+  // -21.7 px senza mai entrare nel raggio di separazione
+  const std::vector<bd::Boid> pair = {bd::Boid(100., 100., 700., 0.),
+                                      bd::Boid(125., 100., -700., 0.)};
+  const double dt = 1. / 30.;
+  SUBCASE("the substep count follows the fastest boid")
+  {
+    bd::Movement mov(pair, 60., 20., 1.5, 0., 0.);
+    CHECK(mov.substep_count(dt) == 1);
+    mov.set_substepping(true);
+    CHECK(mov.substep_count(dt) == 3); // 23.3 px contro 10 px per passo
+    mov.set_substepping(true, 0.5, 2);
+    CHECK(mov.substep_count(dt) == 2);
+    CHECK_THROWS_AS(mov.set_substepping(true, 0.), std::invalid_argument);
+    CHECK_THROWS_AS(mov.set_substepping(true, 0.5, 0), std::invalid_argument);
+  }
+  SUBCASE("substeps catch the separation a single step misses")
+  {
+    bd::Movement single(pair, 60., 20., 1.5, 0., 0.);
+    bd::Movement sub(pair, 60., 20., 1.5, 0., 0.);
+    single.set_stats_interval(0.);
+    sub.set_stats_interval(0.);
+    sub.set_substepping(true);
+    single.update(0, dt);
+    sub.update(0, dt);
+    CHECK(single.get_boids()[0].vel[0] == 700.);
+    CHECK(sub.get_boids()[0].vel[0] < 700.);
+    // stesso spostamento complessivo a meno della separazione
+    CHECK(sub.get_boids()[0].pos[0]
+          == doctest::Approx(single.get_boids()[0].pos[0]).epsilon(0.01));
+  }
+  SUBCASE("slow flocks take a single step")
+  {
+    bd::Movement plain(random_flock(43), 60., 20., 1.5, 0.04, 0.3);
+    bd::Movement sub(random_flock(43), 60., 20., 1.5, 0.04, 0.3);
+    sub.set_substepping(true, 100.);
+    for (int f = 0; f < 5; ++f) {
+      plain.update(f, 1. / 60.);
+      sub.update(f, 1. / 60.);
+    }
+    for (size_t i = 0; i < plain.get_boids().size(); ++i)
+      CHECK(sub.get_boids()[i].pos == plain.get_boids()[i].pos);
+  }
+}
+
+TEST_CASE("Test integrator policies")
+{
+  SUBCASE("semi-implicit Euler is the default and unchanged")
+  {
+    bd::Movement mov;
+    CHECK(mov.get_integrator() == bd::Integrator::semi_implicit_euler);
+  }
+  SUBCASE("constant velocity is integrated exactly by every scheme")
+  {
+    // nessuna regola attiva: tutte le politiche si riducono a x += v h
+    for (auto kind :
+         {bd::Integrator::explicit_euler, bd::Integrator::semi_implicit_euler,
+          bd::Integrator::velocity_verlet, bd::Integrator::rk2}) {
+      bd::Movement mov({bd::Boid(100., 100., 60., -30.)}, 50., 10., 0., 0., 0.);
+      mov.set_stats_interval(0.);
+      mov.set_integrator(kind);
+      mov.update(0, 0.5);
+      CHECK(mov.get_boids()[0].pos[0] == doctest::Approx(130.));
+      CHECK(mov.get_boids()[0].pos[1] == doctest::Approx(85.));
+    }
+  }
+  SUBCASE("higher order schemes approach the small-step reference")
+  {
+    std::vector<bd::Boid> boids;
+    std::mt19937 eng{44};
+    std::uniform_real_distribution<double> p(700., 900.);
+    std::uniform_real_distribution<double> v(-100., 100.);
+    for (int k = 0; k < 150; ++k)
+      boids.emplace_back(p(eng), p(eng) - 350., v(eng), v(eng));
+    auto run = [&](bd::Integrator kind, size_t substeps) {
+      bd::Movement mov(boids, 50., 15., 1.5, 0.04, 0.3);
+      mov.set_stats_interval(0.);
+      mov.set_integrator(kind);
+      mov.set_substepping(substeps > 1, 1e-9, substeps);
+      for (int f = 0; f < 3; ++f)
+        mov.update(f, 1. / 30.);
+      return mov.get_boids();
+    };
+    const std::vector<bd::Boid> ref =
+        run(bd::Integrator::semi_implicit_euler, 256);
+    auto error = [&](const std::vector<bd::Boid>& b) {
+      double sum = 0.;
+      for (size_t i = 0; i < b.size(); ++i)
+        sum += std::hypot(b[i].pos[0] - ref[i].pos[0],
+                          b[i].pos[1] - ref[i].pos[1]);
+      return sum;
+    };
+    const double euler = error(run(bd::Integrator::explicit_euler, 1));
+    const double semi  = error(run(bd::Integrator::semi_implicit_euler, 1));
+    const double rk2   = error(run(bd::Integrator::rk2, 1));
+    const double verl  = error(run(bd::Integrator::velocity_verlet, 1));
+    CHECK(rk2 < euler);
+    CHECK(rk2 < semi);
+    CHECK(verl < semi);
+  }
+  SUBCASE("every scheme keeps the speed limit")
+  {
+    // il repulsore viene superato a metà passo: la forza cambia segno
+    bd::ForceField field;
+    bd::Emitter e;
+    e.a        = {800., 450.};
+    e.radius   = 100.;
+    e.strength = -2000.;
+    field.add(e);
+    for (auto kind :
+         {bd::Integrator::explicit_euler, bd::Integrator::semi_implicit_euler,
+          bd::Integrator::velocity_verlet, bd::Integrator::rk2}) {
+      bd::Movement mov({bd::Boid(795., 450., 700., 0.)}, 50., 10., 0., 0., 0.);
+      mov.set_stats_interval(0.);
+      mov.set_force_field(field);
+      mov.set_integrator(kind);
+      mov.update(0, 1. / 30.);
+      const bd::Velocity& v = mov.get_boids()[0].vel;
+      CHECK(std::hypot(v[0], v[1]) <= bd::Movement::max_speed + 1e-9);
+    }
+  }
+}
+
+TEST_CASE("Test sleeping cells")
+{
+  SUBCASE("a quiet cell falls asleep and an active neighbor wakes it")
+  {
+    bd::ActivityTracker act;
+    act.configure(200., 100., 50., 1., 3);
+    const std::vector<bd::Boid> b = {bd::Boid(10., 10., 5., 0.),
+                                     bd::Boid(160., 10., 5., 0.)};
+    const std::vector<bd::Velocity> still = {{5., 0.}, {5., 0.}};
+    for (int f = 0; f < 3; ++f) {
+      act.begin_frame(b);
+      CHECK_FALSE(act.sleeping(0));
+      act.end_frame(b, still);
+    }
+    act.begin_frame(b);
+    CHECK(act.sleeping(0));
+    CHECK(act.sleeping(1));
+    CHECK(act.active_fraction() == 0.);
+    CHECK(act.sleeping_cells() == 8);
+
+    act.wake_at({160., 10.}, 1.);
+    act.begin_frame(b);
+    CHECK(act.sleeping(0));
+    CHECK_FALSE(act.sleeping(1));
+    // il boid 1 accelera: la cella (3, 0) sveglia la (2, 0) ma non la (0, 0)
+    act.end_frame(b, {{5., 0.}, {50., 0.}});
+    const std::vector<bd::Boid> moved = {bd::Boid(10., 10., 5., 0.),
+                                         bd::Boid(110., 10., 5., 0.)};
+    act.begin_frame(moved);
+    CHECK(act.sleeping(0));
+    CHECK_FALSE(act.sleeping(1));
+    CHECK(act.active_fraction() == doctest::Approx(0.5));
+  }
+  SUBCASE("steady boids are extrapolated exactly and woken on insertion")
+  {
+    std::vector<bd::Boid> boids;
+    for (int k = 0; k < 20; ++k)
+      boids.emplace_back(40. + 75. * k, 100. + 30. * (k % 3), 30., 10.);
+    bd::Movement plain(boids, 20., 5., 1.5, 0.04, 0.3);
+    bd::Movement lazy(boids, 20., 5., 1.5, 0.04, 0.3);
+    plain.set_stats_interval(0.);
+    lazy.set_stats_interval(0.);
+    lazy.set_sleeping(true, 1., 5);
+    for (int f = 0; f < 10; ++f) {
+      plain.update(f, 1. / 60.);
+      lazy.update(f, 1. / 60.);
+    }
+    CHECK(lazy.get_activity().active_fraction() == 0.);
+    for (size_t i = 0; i < boids.size(); ++i)
+      CHECK(lazy.get_boids()[i].pos == plain.get_boids()[i].pos);
+
+    lazy.push_back_(bd::Boid(lazy.get_boids()[0].pos[0] + 5.,
+                             lazy.get_boids()[0].pos[1], -30., 0.));
+    lazy.update(10, 1. / 60.);
+    CHECK(lazy.get_activity().active_fraction() > 0.);
+    CHECK_FALSE(lazy.get_activity().sleeping(0));
+    CHECK_THROWS_AS(lazy.set_sleeping(true, -1.), std::invalid_argument);
+  }
+}
+
+TEST_CASE("Test level-of-detail renderer")
+{
+  bd::FlockRenderer r({1600., 900.}, 160, 90, 700., 100);
+  const sf::View whole(sf::FloatRect(0.f, 0.f, 1600.f, 900.f));
+  SUBCASE("the heatmap is used past the threshold unless zoomed in")
+  {
+    CHECK_FALSE(r.uses_heatmap(100, whole));
+    CHECK(r.uses_heatmap(101, whole));
+    const sf::View zoomed(sf::FloatRect(0.f, 0.f, 160.f, 90.f));
+    CHECK_FALSE(r.uses_heatmap(1000, zoomed));
+    CHECK(r.uses_heatmap(20000, zoomed));
+  }
+  SUBCASE("counts and colors per pixel, serial and parallel")
+  {
+    std::vector<bd::Boid> boids;
+    for (int k = 0; k < 40; ++k)
+      boids.emplace_back(15., 25., 0., 0.); // pixel (1, 2), fermi
+    boids.emplace_back(1595., 895., 700., 0.); // pixel (159, 89)
+    boids.emplace_back(-5., 10., 0., 0.);      // fuori dalla vista
+    r.rasterize(boids, whole);
+    CHECK(r.count_at(1, 2) == 40);
+    CHECK(r.count_at(159, 89) == 1);
+    CHECK(r.count_at(0, 1) == 0);
+    const std::vector<sf::Uint8>& px = r.get_pixels();
+    const size_t still = 4 * (2 * 160 + 1);
+    CHECK(px[still] == 255); // saturo e bianco: tanti boids fermi
+    CHECK(px[still + 1] == 255);
+    const size_t fast = 4 * (89 * 160 + 159);
+    CHECK(px[fast + 1] == 0); // rosso: velocità massima
+    CHECK(px[fast + 3] == 255);
+    CHECK(px[0] == 0); // vuoto: nero opaco
+    CHECK(px[1] == 0);
+    CHECK(px[2] == 0);
+    CHECK(px[3] == 255);
+
+    bd::TaskScheduler pool(4);
+    const std::vector<sf::Uint8> serial = px;
+    r.rasterize(boids, whole, &pool);
+    CHECK(r.get_pixels() == serial);
+    CHECK(r.count_at(1, 2) == 40);
+  }
+}
+
+TEST_CASE("Test headless recording")
+{
+  SUBCASE("CPU rendering of boids and predators")
+  {
+    bd::FlockRenderer r({1600., 900.}, 160, 90, 700., 100);
+    const sf::View whole(sf::FloatRect(0.f, 0.f, 1600.f, 900.f));
+    const std::vector<sf::Uint8>& px =
+        r.render({bd::Boid(10., 10., 0., 0.)}, {bd::Boid(505., 305.)}, whole);
+    const size_t boid = 4 * (1 * 160 + 1);
+    CHECK(px[boid] == 255);
+    CHECK(px[boid + 1] == 255);
+    CHECK(px[boid + 3] == 255);
+    CHECK(px[0] == 0);
+    CHECK(px[3] == 255);
+    const size_t pred = 4 * (30 * 160 + 50);
+    CHECK(px[pred + 1] == 200);
+  }
+  SUBCASE("raw frames are written in order at the given stride")
+  {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "boids_frames.rgb").string();
+    {
+      bd::FrameRecorder rec(path, bd::FrameFormat::raw_rgb, 4, 2, 2, 3, 64);
+      for (int f = 0; f < 10; ++f) {
+        if (!rec.wants(f))
+          continue;
+        std::vector<sf::Uint8> rgba(4 * 2 * 4, static_cast<sf::Uint8>(f));
+        CHECK(rec.submit(f, rgba));
+      }
+      CHECK_THROWS_AS(rec.submit(0, {}), std::invalid_argument);
+      rec.flush();
+      CHECK(rec.written() == 5);
+      CHECK(rec.dropped() == 0);
+    }
+    std::ifstream in(path, std::ios::binary);
+    const std::vector<char> data{std::istreambuf_iterator<char>(in), {}};
+    REQUIRE(data.size() == 5 * 4 * 2 * 3);
+    for (size_t k = 0; k < 5; ++k)
+      CHECK(data[k * 24] == static_cast<char>(2 * k));
+    in.close();
+    std::filesystem::remove(path);
+    CHECK_THROWS_AS(bd::FrameRecorder(path, bd::FrameFormat::png, 4, 2, 0),
+                    std::invalid_argument);
+  }
+}
+
+TEST_CASE("Test camera and view culling")
+{
+  SUBCASE("zoom keeps the point under the cursor and the view in the world")
+  {
+    bd::Camera cam({1600., 900.}, {1600., 900.});
+    cam.zoom_at(4., {400., 300.});
+    CHECK(cam.get_zoom() == doctest::Approx(4.));
+    const bd::Position p = cam.to_world({400., 300.});
+    CHECK(p[0] == doctest::Approx(400.));
+    CHECK(p[1] == doctest::Approx(300.));
+    CHECK(cam.visible_rect().width == doctest::Approx(400.));
+    cam.pan(-1e6, -1e6);
+    CHECK(cam.visible_rect().left == doctest::Approx(0.));
+    CHECK(cam.visible_rect().top == doctest::Approx(0.));
+    cam.zoom_at(0.01, {0., 0.});
+    CHECK(cam.get_zoom() == doctest::Approx(1.));
+    CHECK(cam.get_center()[0] == doctest::Approx(800.));
+    CHECK_THROWS_AS(cam.zoom_at(0., {0., 0.}), std::invalid_argument);
+  }
+  SUBCASE("visible boids match a brute-force scan")
+  {
+    const std::vector<sf::FloatRect> rects{
+        {0.f, 0.f, 100.f, 900.f},
+        {700.f, 300.f, 250.f, 200.f},
+        {1500.f, 0.f, 100.f, 900.f},
+        {0.f, 0.f, 1600.f, 900.f}};
+    for (bd::NeighborSearch mode :
+         {bd::NeighborSearch::grid, bd::NeighborSearch::prefix_sum,
+          bd::NeighborSearch::brute_force}) {
+      bd::Movement mov(random_flock(5), 40., 10., 0.1, 0.1, 0.01);
+      mov.set_neighbor_search(mode);
+      for (int f = 0; f < 5; ++f)
+        mov.update(f, 1. / 60.);
+      mov.push_back_(bd::Boid(30., 30., 0., 0.));
+      mov.update(5, 1. / 60.);
+      std::vector<size_t> seen;
+      for (const sf::FloatRect& r : rects) {
+        mov.visible_boids(r, seen);
+        std::sort(seen.begin(), seen.end());
+        std::vector<size_t> expected;
+        const std::vector<bd::Boid>& b = mov.get_boids();
+        for (size_t i = 0; i < b.size(); ++i)
+          if (b[i].pos[0] >= r.left && b[i].pos[0] < r.left + r.width
+              && b[i].pos[1] >= r.top && b[i].pos[1] < r.top + r.height)
+            expected.push_back(i);
+        CHECK(seen == expected);
+      }
+    }
+    // un boid appena passato dall'altra parte resta nella vecchia cella
+    bd::Movement mov({bd::Boid(1595., 450., 600., 0.), bd::Boid(800., 450.)},
+                     40., 10., 0.1, 0.1, 0.01);
+    mov.set_neighbor_search(bd::NeighborSearch::grid);
+    mov.update(0, 1. / 60.);
+    REQUIRE(mov.get_boids()[0].pos[0] < 100.);
+    std::vector<size_t> seen;
+    mov.visible_boids({0.f, 0.f, 100.f, 900.f}, seen);
+    CHECK(seen == std::vector<size_t>{0});
+  }
+  SUBCASE("culling after an RK2 step")
+  {
+    // l'indice del punto medio non vale per le posizioni finali
+    bd::Movement mov({bd::Boid(1595., 450., 600., 0.), bd::Boid(800., 450.)},
+                     40., 10., 0.1, 0.1, 0.01);
+    mov.set_neighbor_search(bd::NeighborSearch::grid);
+    mov.set_integrator(bd::Integrator::rk2);
+    mov.update(0, 1. / 60.);
+    REQUIRE(mov.get_boids()[0].pos[0] < 100.);
+    std::vector<size_t> seen;
+    mov.visible_boids({0.f, 0.f, 100.f, 900.f}, seen);
+    CHECK(seen == std::vector<size_t>{0});
+
+    bd::Movement flock(random_flock(6), 40., 10., 0.1, 0.1, 0.01);
+    flock.set_neighbor_search(bd::NeighborSearch::grid);
+    flock.set_integrator(bd::Integrator::rk2);
+    for (int f = 0; f < 5; ++f)
+      flock.update(f, 1. / 60.);
+    const sf::FloatRect r(700.f, 300.f, 250.f, 200.f);
+    flock.visible_boids(r, seen);
+    std::sort(seen.begin(), seen.end());
+    std::vector<size_t> expected;
+    const std::vector<bd::Boid>& b = flock.get_boids();
+    for (size_t i = 0; i < b.size(); ++i)
+      if (b[i].pos[0] >= r.left && b[i].pos[0] < r.left + r.width
+          && b[i].pos[1] >= r.top && b[i].pos[1] < r.top + r.height)
+        expected.push_back(i);
+    CHECK(seen == expected);
+  }
+  SUBCASE("group center and culled drawing")
+  {
+    bd::Movement mov({bd::Boid(100., 100.), bd::Boid(110., 120.),
+                      bd::Boid(900., 500.)},
+                     40., 10., 0.1, 0.1, 0.01);
+    const std::optional<bd::Position> g = mov.group_center({105., 105.}, 50.);
+    REQUIRE(g.has_value());
+    CHECK((*g)[0] == doctest::Approx(105.));
+    CHECK((*g)[1] == doctest::Approx(110.));
+    CHECK_FALSE(mov.group_center({1500., 100.}, 50.).has_value());
+
+    bd::FlockRenderer r({1600., 900.}, 160, 90, 700., 0);
+    std::vector<size_t> visible;
+    mov.visible_boids({0.f, 0.f, 800.f, 450.f}, visible);
+    CHECK(visible.size() == 2);
+    r.rasterize(mov.get_boids(), sf::View(sf::FloatRect(0, 0, 1600, 900)),
+                nullptr, &visible);
+    CHECK(r.count_at(10, 10) == 1);
+    CHECK(r.count_at(90, 50) == 0);
+  }
+}
+
+TEST_CASE("Test cached speeds for rendering")
+{
+  SUBCASE("speeds match the final velocities")
+  {
+    for (bd::Integrator kind :
+         {bd::Integrator::semi_implicit_euler, bd::Integrator::rk2,
+          bd::Integrator::velocity_verlet}) {
+      bd::Movement mov(random_flock(9), 40., 10., 0.5, 0.1, 0.05);
+      mov.set_integrator(kind);
+      mov.set_boundary(bd::Boundary::soft_margin);
+      mov.set_substepping(true, 0.1, 4);
+      mov.update(0, 1. / 30.);
+      mov.push_back_(bd::Boid(800., 450., 100., 0.));
+      mov.update(1, 1. / 30.);
+      const std::vector<bd::Boid>& b = mov.get_boids();
+      const std::vector<float>& sp   = mov.get_speeds();
+      REQUIRE(sp.size() == b.size());
+      for (size_t i = 0; i < b.size(); ++i)
+        CHECK(sp[i] == doctest::Approx(mov.get_speed(b[i].vel)).epsilon(1e-5));
+    }
+  }
+  SUBCASE("the renderer uses the given speeds")
+  {
+    bd::FlockRenderer r({1600., 900.}, 160, 90, 700., 100);
+    const sf::View whole(sf::FloatRect(0.f, 0.f, 1600.f, 900.f));
+    const std::vector<bd::Boid> b{bd::Boid(10., 10., 0., 0.)};
+    const std::vector<float> fast{700.f};
+    const size_t p = 4 * (1 * 160 + 1);
+    CHECK(r.render(b, {}, whole, nullptr, &fast)[p + 1] == 0);
+    CHECK(r.render(b, {}, whole)[p + 1] == 255);
+    // senza un modulo per boid vengono ricalcolati
+    const std::vector<float> wrong{700.f, 700.f};
+    CHECK(r.render(b, {}, whole, nullptr, &wrong)[p + 1] == 255);
+  }
+}
+
+TEST_CASE("Test configuration file and command line")
+{
+  SUBCASE("file sections, comments and overrides")
+  {
+    bd::SimConfig cfg;
+    std::istringstream in("# stormo\n"
+                          "[flock]\n"
+                          "count = 2000  # boids\n"
+                          "d = 80\n"
+                          "seed = 7\n"
+                          "[neighbors]\n"
+                          "search = \"grid\"\n"
+                          "[record]\n"
+                          "path = \"out#1.rgb\"\n"
+                          "format = png\n");
+    bd::load_config(cfg, in);
+    CHECK(cfg.n_boids == 2000);
+    CHECK(cfg.d == doctest::Approx(80.));
+    CHECK(cfg.seed == 7);
+    CHECK(cfg.search == bd::NeighborSearch::grid);
+    CHECK(cfg.record_path == "out#1.rgb");
+    CHECK(cfg.record_format == bd::FrameFormat::png);
+    CHECK(cfg.d_s == doctest::Approx(20.)); // valore predefinito
+    CHECK_NOTHROW(bd::validate(cfg));
+
+    const char* argv[] = {"boids_sim", "--headless", "--threads.mode",
+                          "work_stealing", "--flock.count", "10"};
+    const bd::SimConfig cli = bd::parse_command_line(6, argv);
+    CHECK(cli.headless);
+    CHECK(cli.threading == bd::ThreadingMode::work_stealing);
+    CHECK(cli.n_boids == 10);
+  }
+  SUBCASE("malformed input and validation errors")
+  {
+    bd::SimConfig cfg;
+    std::istringstream unknown("[flock]\nspeed = 3\n");
+    CHECK_THROWS_WITH_AS(bd::load_config(cfg, unknown),
+                         "riga 2: Parametro sconosciuto: flock.speed",
+                         std::invalid_argument);
+    CHECK_THROWS_AS(bd::set_option(cfg, "flock.count", "-5"),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(bd::set_option(cfg, "flock.d", "3x"),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(bd::set_option(cfg, "motion.integrator", "leapfrog"),
+                    std::invalid_argument);
+    const char* argv[] = {"boids_sim", "--flock.d"};
+    CHECK_THROWS_AS(bd::parse_command_line(2, argv), std::invalid_argument);
+
+    cfg.d_s = 100.;
+    CHECK_THROWS_AS(bd::validate(cfg), std::invalid_argument);
+    cfg     = {};
+    cfg.a   = 1.5;
+    CHECK_THROWS_AS(bd::validate(cfg), std::invalid_argument);
+    cfg     = {};
+    cfg.fps = 0;
+    CHECK_THROWS_AS(bd::validate(cfg), std::invalid_argument);
+
+    auto rejects = [](const char* key, const char* value) {
+      bd::SimConfig c;
+      bd::set_option(c, key, value);
+      CHECK_THROWS_AS(bd::validate(c), std::invalid_argument);
+    };
+    rejects("neighbors.theta", "-0.1");
+    rejects("neighbors.fov", "0");
+    rejects("neighbors.fov", "361");
+    rejects("stats.error", "1");
+    rejects("stats.interval", "-1");
+    rejects("motion.substep_fraction", "0");
+    rejects("motion.max_substeps", "0");
+    rejects("motion.margin", "500");
+    rejects("motion.turn", "-1");
+    rejects("motion.sleep_frames", "0");
+    rejects("threads.rebalance_every", "0");
+    rejects("threads.migration_cost", "-1");
+    rejects("species.count", "9");
+    rejects("threads.mode", "sockets"); // serve --headless
+
+    // la 3D non ha le opzioni del modello 2D
+    bd::SimConfig three;
+    three.three_d = true;
+    CHECK_NOTHROW(bd::validate(three));
+    bd::set_option(three, "stats.interval", "0");
+    CHECK_NOTHROW(bd::validate(three));
+    for (auto [key, value] :
+         {std::pair{"species.count", "2"}, {"neighbors.fov", "270"},
+          {"motion.boundary", "reflective"}, {"predators.count", "1"},
+          {"forces.point", "1, 2, 3, 4"}, {"threads.mode", "partition"}}) {
+      bd::SimConfig c = three;
+      bd::set_option(c, key, value);
+      CHECK_THROWS_AS(bd::validate(c), std::invalid_argument);
+    }
+    CHECK_THROWS_AS(bd::set_option(cfg, "obstacles.circle", "1, 2"),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(bd::set_option(cfg, "forces.point", "1, 2, 3, 4, fast"),
+                    std::invalid_argument);
+  }
+  SUBCASE("species, predators, obstacles and force emitters")
+  {
+    bd::SimConfig cfg;
+    std::istringstream in("[species]\n"
+                          "count = 3\n"
+                          "cross_s = 2\n"
+                          "[predators]\n"
+                          "count = 2\n"
+                          "[obstacles]\n"
+                          "circle = \"400, 300, 50\"\n"
+                          "circle = 800, 300, 20\n"
+                          "wall = 100, 100, 300, 100\n"
+                          "polygon = \"900, 500, 1000, 500, 950, 600\"\n"
+                          "[forces]\n"
+                          "point = \"800, 450, 120, 30, linear\"\n"
+                          "region = 0, 0, 200, 200, 50, -20\n"
+                          "[motion]\n"
+                          "boundary = soft_margin\n"
+                          "margin = 80\n"
+                          "turn = 10\n"
+                          "sleep_threshold = 2\n"
+                          "sleep_frames = 5\n"
+                          "[threads]\n"
+                          "mode = sockets\n"
+                          "transport = tcp\n"
+                          "migration_cost = 0.5\n");
+    bd::load_config(cfg, in);
+    CHECK(cfg.n_species == 3);
+    CHECK(cfg.cross_s == doctest::Approx(2.));
+    CHECK(cfg.n_predators == 2);
+    CHECK(cfg.obstacles.get_circles().size() == 2);
+    CHECK(cfg.obstacles.get_walls().size() == 1);
+    REQUIRE(cfg.obstacles.get_polygons().size() == 1);
+    CHECK(cfg.obstacles.get_polygons()[0].size() == 3);
+    const std::vector<bd::Emitter>& em = cfg.forces.get_emitters();
+    REQUIRE(em.size() == 2);
+    CHECK(em[0].shape == bd::Emitter::Shape::point);
+    CHECK(em[0].falloff == bd::Emitter::Falloff::linear);
+    CHECK(em[0].radius == doctest::Approx(120.));
+    CHECK(em[1].shape == bd::Emitter::Shape::region);
+    CHECK(em[1].b[0] == doctest::Approx(200.));
+    CHECK(em[1].strength == doctest::Approx(-20.));
+    bd::set_option(cfg, "forces.region", "500, 500, 100, 100, 50, 10");
+    REQUIRE(em.size() == 3);
+    CHECK(em[2].a == bd::Position{100., 100.});
+    CHECK(em[2].b == bd::Position{500., 500.});
+    CHECK(cfg.margin == doctest::Approx(80.));
+    CHECK(cfg.turn == doctest::Approx(10.));
+    CHECK(cfg.sleep_threshold == doctest::Approx(2.));
+    CHECK(cfg.sleep_frames == 5);
+    CHECK(cfg.threading == bd::ThreadingMode::sockets);
+    CHECK(cfg.transport == bd::Transport::tcp);
+    CHECK(cfg.migration_cost == doctest::Approx(0.5));
+    cfg.headless = true;
+    // le strisce su processi separati non conoscono specie e ostacoli
+    CHECK_THROWS_AS(bd::validate(cfg), std::invalid_argument);
+    cfg.threading = bd::ThreadingMode::serial;
+    CHECK_NOTHROW(bd::validate(cfg));
+    bd::Movement mov({bd::Boid(300., 300., 0., 0.)}, 40., 10., 0., 0., 0.);
+    mov.set_force_field(cfg.forces);
+    CHECK_NOTHROW(mov.update(0, 1. / 60.));
+  }
+  SUBCASE("the world size reaches the model")
+  {
+    bd::Movement mov({bd::Boid(3990., 10., 600., 0.)}, 40., 10., 0.1, 0.1,
+                     0.01, {4000., 2000.});
+    CHECK(mov.get_world()[0] == doctest::Approx(4000.));
+    mov.update(0, 1. / 60.);
+    CHECK(mov.get_boids()[0].pos[0] < 10.);
+    bd::Position p{2500., 1500.};
+    mov.check_sides(p);
+    CHECK(p[0] == doctest::Approx(2500.));
+    CHECK_THROWS_AS(bd::Movement({}, 40., 10., 0.1, 0.1, 0.01, {0., 10.}),
+                    std::invalid_argument);
+  }
+}
+
 TEST_CASE("Test update_pos_vel basic movement")
 {
   std::vector<bd::Boid> boids = {bd::Boid(0.0, 0.0, 200.0, 200.0)};
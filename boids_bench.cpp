@@ -0,0 +1,177 @@
+#include "boids_logic.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+
+// benchmark dell'aggiornamento su più thread: stormo uniforme e stormo con
+// il 90% dei boids in una sola regione, con la partizione ORB e con il work
+// stealing, raddoppiando i thread fino a max_threads
+// uso: boids_bench [n_boids] [max_threads] [frames]
+//
+// confronto degli integratori: errore sulle posizioni rispetto a una corsa
+// di riferimento con 64 sottopassi per frame, e costo per frame, per ogni
+// integratore con 1, 2, 4 e 8 sottopassi; indica il più economico entro
+// budget pixel di errore quadratico medio
+// uso: boids_bench integratori [n_boids] [frames] [budget]
+
+namespace {
+std::vector<bd::Boid> make_flock(size_t n, bool clustered, unsigned seed)
+{
+  std::mt19937 eng{seed};
+  std::uniform_real_distribution<double> x(0., bd::Movement::screen_width);
+  std::uniform_real_distribution<double> y(0., bd::Movement::screen_height);
+  std::uniform_real_distribution<double> cx(700., 900.);
+  std::uniform_real_distribution<double> cy(350., 550.);
+  std::uniform_real_distribution<double> v(-200., 200.);
+  std::vector<bd::Boid> boids;
+  for (size_t i = 0; i < n; ++i) {
+    if (clustered && i % 10 != 0)
+      boids.emplace_back(cx(eng), cy(eng), v(eng), v(eng));
+    else
+      boids.emplace_back(x(eng), y(eng), v(eng), v(eng));
+  }
+  return boids;
+}
+
+// millisecondi per frame
+double time_run(const std::vector<bd::Boid>& boids, size_t threads,
+                bool stealing, int frames)
+{
+  bd::Movement mov(boids, 50., 15., 1.5, 0.04, 0.3);
+  mov.set_neighbor_search(bd::NeighborSearch::grid);
+  mov.set_stats_interval(0.);
+  if (threads > 1) {
+    mov.set_threads(threads, 5);
+    mov.set_work_stealing(stealing);
+  }
+  mov.update(0, 1. / 60.); // riscaldamento
+  const auto start = std::chrono::steady_clock::now();
+  for (int f = 1; f <= frames; ++f)
+    mov.update(f, 1. / 60.);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / frames;
+}
+
+struct IntegratorRun
+{
+  std::vector<bd::Boid> boids;
+  double ms_per_frame = 0.;
+};
+
+IntegratorRun run_integrator(const std::vector<bd::Boid>& boids,
+                             bd::Integrator kind, size_t substeps, int frames)
+{
+  bd::Movement mov(boids, 50., 15., 1.5, 0.04, 0.3);
+  mov.set_neighbor_search(bd::NeighborSearch::grid);
+  mov.set_stats_interval(0.);
+  mov.set_integrator(kind);
+  // frazione minima: il numero di sottopassi è sempre substeps
+  mov.set_substepping(substeps > 1, 1e-9, substeps);
+  const auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; ++f)
+    mov.update(f, 1. / 30.);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return {mov.get_boids(), elapsed.count() / frames};
+}
+
+// errore quadratico medio sulle posizioni, con la distanza minima sul toro
+double rms_error(const std::vector<bd::Boid>& a, const std::vector<bd::Boid>& b)
+{
+  auto wrap = [](double x, double len) {
+    x = std::fmod(std::abs(x), len);
+    return std::min(x, len - x);
+  };
+  double sum = 0.;
+  for (size_t i = 0; i < a.size(); ++i) {
+    const double dx =
+        wrap(a[i].pos[0] - b[i].pos[0], bd::Movement::screen_width);
+    const double dy =
+        wrap(a[i].pos[1] - b[i].pos[1], bd::Movement::screen_height);
+    sum += dx * dx + dy * dy;
+  }
+  return std::sqrt(sum / static_cast<double>(a.size()));
+}
+
+int bench_integrators(int argc, char* argv[])
+{
+  const size_t n_boids = argc > 2 ? std::stoul(argv[2]) : 2000;
+  const int frames     = argc > 3 ? std::stoi(argv[3]) : 10;
+  const double budget  = argc > 4 ? std::stod(argv[4]) : 5.;
+  const std::vector<bd::Boid> boids = make_flock(n_boids, true, 1);
+  const IntegratorRun ref =
+      run_integrator(boids, bd::Integrator::semi_implicit_euler, 64, frames);
+
+  const std::pair<bd::Integrator, const char*> kinds[] = {
+      {bd::Integrator::explicit_euler, "Eulero esplicito"},
+      {bd::Integrator::semi_implicit_euler, "Eulero semi-impl."},
+      {bd::Integrator::velocity_verlet, "Verlet"},
+      {bd::Integrator::rk2, "RK2"}};
+  std::cout << "boids: " << n_boids << ", frame: " << frames
+            << ", budget: " << budget << " px\n"
+            << std::left << std::setw(20) << "integratore" << std::setw(11)
+            << "sottopassi" << std::setw(12) << "ms/frame" << "errore px\n";
+  const char* best_name = nullptr;
+  size_t best_steps     = 0;
+  double best_ms        = 0.;
+  for (const auto& [kind, name] : kinds) {
+    for (size_t k = 1; k <= 8; k *= 2) {
+      const IntegratorRun run = run_integrator(boids, kind, k, frames);
+      const double err        = rms_error(run.boids, ref.boids);
+      std::cout << std::setw(20) << name << std::setw(11) << k
+                << std::setw(12) << std::fixed << std::setprecision(2)
+                << run.ms_per_frame << std::setprecision(4) << err << '\n';
+      if (err <= budget
+          && (best_name == nullptr || run.ms_per_frame < best_ms)) {
+        best_name  = name;
+        best_steps = k;
+        best_ms    = run.ms_per_frame;
+      }
+    }
+  }
+  if (best_name != nullptr)
+    std::cout << "più economico entro il budget: " << best_name << " con "
+              << best_steps << " sottopassi\n";
+  else
+    std::cout << "nessun integratore entro il budget\n";
+  return EXIT_SUCCESS;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && std::string(argv[1]) == "integratori")
+    return bench_integrators(argc, argv);
+  const size_t n_boids = argc > 1 ? std::stoul(argv[1]) : 20000;
+  const size_t hw      = std::max(std::thread::hardware_concurrency(), 1u);
+  const size_t max_threads =
+      argc > 2 ? std::stoul(argv[2]) : std::min<size_t>(64, hw);
+  const int frames = argc > 3 ? std::stoi(argv[3]) : 20;
+
+  std::cout << "boids: " << n_boids << ", core disponibili: " << hw << '\n'
+            << std::left << std::setw(10) << "stormo" << std::setw(14)
+            << "modo" << std::setw(8) << "thread" << std::setw(12)
+            << "ms/frame" << "speedup\n";
+  for (const bool clustered : {false, true}) {
+    const std::vector<bd::Boid> boids = make_flock(n_boids, clustered, 1);
+    const double base                 = time_run(boids, 1, false, frames);
+    for (const bool stealing : {false, true}) {
+      for (size_t t = 1; t <= max_threads; t *= 2) {
+        const double ms = t == 1 ? base : time_run(boids, t, stealing, frames);
+        std::cout << std::setw(10) << (clustered ? "cluster" : "uniforme")
+                  << std::setw(14) << (stealing ? "work stealing" : "ORB")
+                  << std::setw(8) << t << std::setw(12) << std::fixed
+                  << std::setprecision(2) << ms << base / ms << '\n';
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,7 +1,13 @@
 #include "boids_logic.hpp"
+#include "rules.hpp"
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
 
 namespace bd {
 
@@ -11,7 +17,7 @@ Boid::Boid(double x_, double y_, double v_x_, double v_y_)
 {}
 
 Movement::Movement(const std::vector<Boid>& b_, double d_, double d_s_,
-                   double s_, double a_, double c_)
+                   double s_, double a_, double c_, const Position& world_)
     : boids{b_}
     , n_b{b_.size()}
     , d{d_}
@@ -19,25 +25,58 @@ Movement::Movement(const std::vector<Boid>& b_, double d_, double d_s_,
     , s{s_}
     , a{a_}
     , c{c_}
-{}
+    , balancer{world_, 1}
+    , arena{world_[0], world_[1]}
+{
+  if (!(world_[0] > 0.) || !(world_[1] > 0.))
+    throw std::invalid_argument("Le dimensioni del mondo devono essere "
+                                "positive");
+}
 // aggiungi un boid
 void Movement::push_back_(const Boid& bo)
 {
-  boids.push_back(bo);
+  if (species_matrix.empty()) {
+    boids.push_back(bo);
+  } else {
+    // il nuovo boid va in coda alla sua specie
+    if (bo.species >= n_species())
+      throw std::invalid_argument("Specie del boid non valida");
+    const size_t at = species_start[bo.species + 1];
+    boids.insert(boids.begin() + static_cast<std::ptrdiff_t>(at), bo);
+    for (size_t t = bo.species + 1; t < species_start.size(); ++t)
+      ++species_start[t];
+    activity.reset(); // gli indici dei boids sono cambiati
+  }
   ++n_b;
   assert(n_b == boids.size());
+  activity.wake_at(bo.pos, d);
+  index_current = false;
 }
 // rimuovi un boid
 void Movement::remove_()
 {
   if (boids.empty() == false) {
     auto it = boids.end() - 1;
+    activity.wake_at(it->pos, d);
     boids.erase(it);
     --n_b;
     assert(n_b == boids.size());
+    for (size_t& start : species_start)
+      start = std::min(start, n_b);
+    index_current = false;
   }
 }
 
+Position Movement::get_world() const
+{
+  return {arena.width, arena.height};
+}
+
+const std::vector<float>& Movement::get_speeds() const
+{
+  return speeds;
+}
+
 const std::vector<Boid>& Movement::get_boids() const
 {
   return boids;
@@ -45,13 +84,12 @@ const std::vector<Boid>& Movement::get_boids() const
 
 double Movement::get_speed(const Velocity& vel) const
 {
-  return std::sqrt(vel[0] * vel[0] + vel[1] * vel[1]);
+  return std::sqrt(norm2(vel));
 }
 
 double Movement::diff_pos2(const Position& pos_i, const Position& pos_j) const
 {
-  return (pos_i[0] - pos_j[0]) * (pos_i[0] - pos_j[0])
-       + (pos_i[1] - pos_j[1]) * (pos_i[1] - pos_j[1]);
+  return dist2(pos_i, pos_j);
 } // evitiamo di fare la radice per ottimizzare
 
 bool Movement::is_neighbor(const Position& pos_i, const Position& pos_j) const
@@ -62,47 +100,121 @@ bool Movement::is_neighbor(const Position& pos_i, const Position& pos_j) const
 // Separazione: allontana se troppo vicini
 Velocity Movement::rule1(const Position& pos_i, const Position& pos_j) const
 {
-  if (diff_pos2(pos_i, pos_j) < d_s * d_s) {
-    return {-s * (pos_j[0] - pos_i[0]), -s * (pos_j[1] - pos_i[1])};
-  }
-  return {0., 0.};
+  return rule1(pos_i, pos_j, s);
+}
+
+Velocity Movement::rule1(const Position& pos_i, const Position& pos_j,
+                         double s_) const
+{
+  return separation(pos_i, pos_j, d_s, s_);
 }
 
 // Allineamento: avvicina alla velocità media dei vicini
 Velocity Movement::rule2(const Velocity& vel_i, const Velocity& mean_vel) const
 {
-  return Velocity{a * (mean_vel[0] - vel_i[0]), a * (mean_vel[1] - vel_i[1])};
+  return rule2(vel_i, mean_vel, a);
+}
+
+Velocity Movement::rule2(const Velocity& vel_i, const Velocity& mean_vel,
+                         double a_) const
+{
+  return alignment(vel_i, mean_vel, a_);
 }
 
 // Coesione: avvicina al centro dei vicini
 Velocity Movement::rule3(const Position& pos_i,
                          const Position& center_mass) const
 {
-  return {c * (center_mass[0] - pos_i[0]), c * (center_mass[1] - pos_i[1])};
+  return rule3(pos_i, center_mass, c);
+}
+
+Velocity Movement::rule3(const Position& pos_i, const Position& center_mass,
+                         double c_) const
+{
+  return cohesion(pos_i, center_mass, c_);
+}
+
+void Movement::set_species(size_t n_species_,
+                           const std::vector<Interaction>& matrix)
+{
+  if (n_species_ < 1 || n_species_ > max_species)
+    throw std::invalid_argument("Numero di specie non valido");
+  if (matrix.size() != n_species_ * n_species_)
+    throw std::invalid_argument(
+        "La matrice di interazione deve avere S x S elementi");
+  for (const Boid& bo : boids) {
+    if (bo.species >= n_species_)
+      throw std::invalid_argument("Specie del boid non valida");
+  }
+
+  species_matrix = matrix;
+  activity.reset();
+  std::stable_sort(boids.begin(), boids.end(),
+                   [](const Boid& l, const Boid& r) {
+                     return l.species < r.species;
+                   });
+  species_start.assign(n_species_ + 1, 0);
+  for (const Boid& bo : boids)
+    ++species_start[bo.species + 1];
+  for (size_t t = 0; t < n_species_; ++t)
+    species_start[t + 1] += species_start[t];
+  build_index();
+}
+
+size_t Movement::n_species() const
+{
+  return species_matrix.empty() ? 1 : species_start.size() - 1;
+}
+
+Interaction Movement::interaction(size_t s_i, size_t s_j) const
+{
+  if (species_matrix.empty())
+    return {s, a, c};
+  return species_matrix[s_i * n_species() + s_j];
 }
 
 // effetto pacman
 void Movement::check_sides(Position& i)
 {
-  if (i[0] >= screen_width)
-    i[0] -= screen_width;
-  if (i[0] < 0)
-    i[0] += screen_width;
-  if (i[1] >= screen_height)
-    i[1] -= screen_height;
-  if (i[1] < 0)
-    i[1] += screen_height;
+  wrap(i, Position{arena.width, arena.height});
+}
+
+void Movement::set_boundary(Boundary mode, double margin, double turn)
+{
+  if (margin <= 0. || 2. * margin > std::min(arena.width, arena.height))
+    throw std::invalid_argument(
+        "Il margine deve essere positivo e minore di metà dell'arena");
+  if (turn < 0.)
+    throw std::invalid_argument("La spinta dai bordi non può essere negativa");
+  boundary     = mode;
+  arena.margin = margin;
+  arena.turn   = turn;
 }
 
-void Movement::limit_velocity(Velocity& v)
+Boundary Movement::get_boundary() const
 {
-  double speed = get_speed(v);
-  if (speed > max_speed) {
-    double scale = max_speed / speed;
-    v[0] *= scale;
-    v[1] *= scale;
+  return boundary;
+}
+
+void Movement::confine(Position& p, Velocity& v) const
+{
+  switch (boundary) {
+  case Boundary::periodic:
+    PeriodicBoundary::confine(p, v, arena);
+    break;
+  case Boundary::reflective:
+    ReflectiveBoundary::confine(p, v, arena);
+    break;
+  case Boundary::soft_margin:
+    SoftMarginBoundary::confine(p, v, arena);
+    break;
   }
 }
+
+double Movement::limit_velocity(Velocity& v)
+{
+  return limit_speed(v, static_cast<double>(max_speed));
+}
 // aggiorna l'interazione col puntatore
 void Movement::set_mouse_force(const sf::Vector2f& pos, bool pressed,
                                bool switch_mouse_force)
@@ -113,150 +225,796 @@ void Movement::set_mouse_force(const sf::Vector2f& pos, bool pressed,
     mouse_force_active = !mouse_force_active;
 }
 
-void Movement::time_stats(const int frame, const double dt)
+// il frame non attende mai le statistiche: lo stato viene copiato e
+// passato al thread che le calcola
+void Movement::time_stats(const int frame, const double dt,
+                          bool with_metrics)
 {
+  if (stats_interval <= 0.)
+    return;
   time_accum += dt;
   if (time_accum >= stats_interval) {
-    print_stats(frame);
+    if (!stats_worker)
+      stats_worker = std::make_unique<StatsWorker>(&std::cout, stats_error);
+    stats_worker->submit(frame, boids,
+                         with_metrics ? last_metrics : std::nullopt);
     time_accum -= (stats_interval);
   }
 }
 
+void Movement::set_stats_interval(double seconds)
+{
+  if (seconds < 0.)
+    throw std::invalid_argument("L'intervallo delle statistiche non può "
+                                "essere negativo");
+  stats_interval = seconds;
+  time_accum     = 0.;
+}
+
+double Movement::get_stats_interval() const
+{
+  return stats_interval;
+}
+
+void Movement::set_stats_error(double rel_error)
+{
+  if (rel_error <= 0. || rel_error >= 1.)
+    throw std::invalid_argument(
+        "L'errore relativo deve essere compreso tra 0 e 1");
+  stats_error = rel_error;
+  stats_worker.reset(); // ricreato con il nuovo errore alla prossima stampa
+}
+
+std::optional<FlockStats> Movement::poll_stats()
+{
+  if (!stats_worker)
+    return std::nullopt;
+  return stats_worker->poll();
+}
+
+void Movement::set_flock_metrics(bool on)
+{
+  metrics_enabled = on;
+}
+
+const std::optional<FlockMetrics>& Movement::get_flock_metrics() const
+{
+  return last_metrics;
+}
+
+void Movement::set_neighbor_search(NeighborSearch mode, double theta_)
+{
+  assert(theta_ >= 0.);
+  search = mode;
+  theta  = theta_;
+  build_index();
+}
+
+void Movement::set_field_of_view(double fov_degrees)
+{
+  if (fov_degrees <= 0. || fov_degrees > 360.)
+    throw std::invalid_argument(
+        "Il campo visivo deve essere compreso tra 0 e 360 gradi");
+  fov_cos = fov_degrees >= 360.
+              ? -1.
+              : std::cos(fov_degrees * std::numbers::pi / 360.);
+}
+
+double Movement::view_cos(const Boid& b) const
+{
+  if (b.fov <= 0.)
+    return fov_cos;
+  return b.fov >= 360. ? -1. : std::cos(b.fov * std::numbers::pi / 360.);
+}
+
+void Movement::build_index()
+{
+  switch (search) {
+  case NeighborSearch::barnes_hut:
+    tree.build(boids);
+    break;
+  case NeighborSearch::grid:
+    cells.build(boids, d, false);
+    break;
+  case NeighborSearch::prefix_sum:
+    cells.build(boids, d / prefix_cells_per_d, true);
+    break;
+  case NeighborSearch::brute_force:
+    break;
+  }
+  index_current = search == NeighborSearch::grid
+               || search == NeighborSearch::prefix_sum;
+  index_reach = 0.;
+  if (!predators.empty()) {
+    prey_cells.build(boids, flee_radius, false);
+    threat_cells.build(predators, flee_radius, false);
+  } else {
+    // senza predatori nessuna griglia deve riferirsi a quelli rimossi
+    prey_cells.clear();
+    threat_cells.clear();
+  }
+}
+
+namespace {
+// intervalli di celle lungo un asse, fusi se si toccano
+struct CellRanges
+{
+  std::array<std::pair<size_t, size_t>, 3> r;
+  size_t n = 0;
+
+  void add(size_t first, size_t last)
+  {
+    r[n++] = {first, last};
+    std::sort(r.begin(), r.begin() + static_cast<std::ptrdiff_t>(n));
+    size_t m = 0;
+    for (size_t k = 1; k < n; ++k) {
+      if (r[k].first <= r[m].second + 1)
+        r[m].second = std::max(r[m].second, r[k].second);
+      else
+        r[++m] = r[k];
+    }
+    n = m + 1;
+  }
+};
+} // namespace
+
+void Movement::visible_boids(const sf::FloatRect& rect,
+                             std::vector<size_t>& out)
+{
+  out.clear();
+  if (boids.empty())
+    return;
+  const bool reuse = index_current && !cells.empty();
+  if (!reuse)
+    view_cells.build(boids, view_cell, false);
+  const CellGrid& g = reuse ? cells : view_cells;
+  const double pad  = reuse ? index_reach : 0.;
+  const double x_0  = rect.left;
+  const double y_0  = rect.top;
+  const double x_1  = x_0 + rect.width;
+  const double y_1  = y_0 + rect.height;
+
+  // con i bordi periodici un boid appena passato dall'altra parte è ancora
+  // nella cella vicino al bordo opposto
+  const bool wraps = reuse && boundary == Boundary::periodic && pad > 0.;
+  auto axis = [&](double lo, double hi, double size, auto cell_of) {
+    CellRanges cr;
+    cr.add(cell_of(lo - pad), cell_of(hi + pad));
+    if (wraps && lo < pad)
+      cr.add(cell_of(size - pad), cell_of(size));
+    if (wraps && hi > size - pad)
+      cr.add(cell_of(0.), cell_of(pad));
+    return cr;
+  };
+  const CellRanges xs =
+      axis(x_0, x_1, arena.width, [&g](double x) { return g.cell_x(x); });
+  const CellRanges ys =
+      axis(y_0, y_1, arena.height, [&g](double y) { return g.cell_y(y); });
+
+  auto keep = [&](size_t i) {
+    const Position& p = boids[i].pos;
+    if (p[0] >= x_0 && p[0] < x_1 && p[1] >= y_0 && p[1] < y_1)
+      out.push_back(i);
+  };
+  for (size_t ky = 0; ky < ys.n; ++ky)
+    for (size_t kx = 0; kx < xs.n; ++kx)
+      g.for_each_in_cells(xs.r[kx].first, ys.r[ky].first, xs.r[kx].second,
+                          ys.r[ky].second, keep);
+}
+
+std::optional<Position> Movement::group_center(const Position& p, double r)
+{
+  const auto box = sf::FloatRect(
+      static_cast<float>(p[0] - r), static_cast<float>(p[1] - r),
+      static_cast<float>(2. * r), static_cast<float>(2. * r));
+  visible_boids(box, group_scratch);
+  Position sum{0., 0.};
+  size_t count = 0;
+  for (size_t i : group_scratch) {
+    if (diff_pos2(boids[i].pos, p) < r * r) {
+      sum[0] += boids[i].pos[0];
+      sum[1] += boids[i].pos[1];
+      ++count;
+    }
+  }
+  if (count == 0)
+    return std::nullopt;
+  return Position{sum[0] / static_cast<double>(count),
+                  sum[1] / static_cast<double>(count)};
+}
+
 // Calcola le regole basate sui vicini e aggiorna la velocità
 void Movement::apply_neighbor_rules(size_t i, Velocity& v_i)
 {
   Boid& self = boids[i];
-  Position center_mass{};
-  Velocity mean_vel{};
-  int neighbor_count = 0;
+  // somme dei vicini separate per specie (la sola 0 senza matrice)
+  const bool multi = !species_matrix.empty();
+  const size_t s_i = multi ? self.species : 0;
+  std::array<NeighborSums, max_species> sums{};
 
-  for (size_t j = 0; j < n_b; ++j) {
+  auto add_neighbor = [&](size_t j) {
     if (i == j)
-      continue;
+      return;
     const Boid& other = boids[j];
-    if (is_neighbor(self.pos, other.pos)) {
-      center_mass[0] += other.pos[0];
-      center_mass[1] += other.pos[1];
-      mean_vel[0] += other.vel[0];
-      mean_vel[1] += other.vel[1];
-      neighbor_count++;
-      add_inplace(v_i, rule1(self.pos, other.pos));
+    const size_t t    = multi ? other.species : 0;
+    add_inplace(sums[t].pos_sum, other.pos);
+    add_inplace(sums[t].vel_sum, other.vel);
+    sums[t].count++;
+    add_inplace(v_i, rule1(self.pos, other.pos, interaction(s_i, t).s));
+    if (metrics_frame)
+      clusters.unite(i, j);
+  };
+  // le somme aggregate contano anche il boid stesso (distanza nulla);
+  // la separazione resta esatta, rule1 con se stesso dà contributo nullo
+  auto remove_self = [&]() {
+    if (d > 0) {
+      sums[0].pos_sum[0] -= self.pos[0];
+      sums[0].pos_sum[1] -= self.pos[1];
+      sums[0].vel_sum[0] -= self.vel[0];
+      sums[0].vel_sum[1] -= self.vel[1];
+      --sums[0].count;
+    }
+  };
+  auto separate = [&](size_t j) {
+    add_inplace(v_i, rule1(self.pos, boids[j].pos));
+  };
+
+  // campo visivo: le somme aggregate non distinguono la direzione né la
+  // specie, quindi in questi casi si visitano sempre i vicini uno per uno
+  const double cos_half = view_cos(self);
+  const bool limited    = cos_half > -1.;
+  const bool exact      = limited || multi;
+  auto add_visible      = [&](size_t j) {
+    const Position rel{boids[j].pos[0] - self.pos[0],
+                       boids[j].pos[1] - self.pos[1]};
+    if (!limited || in_view(self.vel, rel, cos_half))
+      add_neighbor(j);
+  };
+
+  if (search == NeighborSearch::barnes_hut && !tree.empty()) {
+    if (exact) {
+      tree.for_each_within(self.pos, d, add_visible);
+    } else {
+      sums[0] = tree.neighbor_sums(self.pos, d, theta);
+      remove_self();
+      tree.for_each_within(self.pos, std::min(d, d_s), separate);
+      if (metrics_frame)
+        tree.for_each_within(self.pos, d,
+                             [&](size_t j) { clusters.unite(i, j); });
+    }
+  } else if (search == NeighborSearch::prefix_sum && !cells.empty()) {
+    if (exact) {
+      cells.for_each_within(self.pos, d, add_neighbor, self.vel, cos_half);
+    } else {
+      sums[0] = cells.neighbor_sums(self.pos, d);
+      remove_self();
+      cells.for_each_within(self.pos, std::min(d, d_s), separate);
+      if (metrics_frame)
+        cells.for_each_within(self.pos, d,
+                              [&](size_t j) { clusters.unite(i, j); });
+    }
+  } else if (search == NeighborSearch::grid && !cells.empty()) {
+    cells.for_each_within(self.pos, d, add_neighbor, self.vel, cos_half);
+  } else {
+    // i boids sono contigui per specie: i coefficienti di ogni coppia di
+    // specie si leggono una volta e le specie che non interagiscono col
+    // boid vengono saltate in blocco, tranne nei frame delle metriche che
+    // contano tutti i vicini come le altre ricerche
+    for (size_t t = 0; t < n_species(); ++t) {
+      const Interaction k = interaction(s_i, t);
+      if (!metrics_frame && k.s == 0. && k.a == 0. && k.c == 0.)
+        continue;
+      const size_t first = multi ? species_start[t] : 0;
+      const size_t last  = multi ? species_start[t + 1] : n_b;
+      NeighborSums& st   = sums[t];
+      for (size_t j = first; j < last; ++j) {
+        const Boid& other = boids[j];
+        if (j == i || !is_neighbor(self.pos, other.pos))
+          continue;
+        if (limited) {
+          const Position rel{other.pos[0] - self.pos[0],
+                             other.pos[1] - self.pos[1]};
+          if (!in_view(self.vel, rel, cos_half))
+            continue;
+        }
+        add_inplace(st.pos_sum, other.pos);
+        add_inplace(st.vel_sum, other.vel);
+        st.count++;
+        add_inplace(v_i, rule1(self.pos, other.pos, k.s));
+        if (metrics_frame)
+          clusters.unite(i, j);
+      }
     }
   }
-  // Applica regole 2 e 3 se ci sono vicini
-  if (neighbor_count > 0) {
-    center_mass[0] /= neighbor_count;
-    center_mass[1] /= neighbor_count;
-    mean_vel[0] /= neighbor_count;
-    mean_vel[1] /= neighbor_count;
-
-    add_inplace(v_i, rule2(self.vel, mean_vel));
-    add_inplace(v_i, rule3(self.pos, center_mass));
+  if (metrics_frame) {
+    int count = 0;
+    for (size_t t = 0; t < n_species(); ++t)
+      count += sums[t].count;
+    neighbor_count[i] = count;
   }
+  for (size_t t = 0; t < n_species(); ++t)
+    apply_neighbor_sums(self, sums[t], interaction(s_i, t), v_i);
 }
-// Applica la forza del mouse (attrattiva o repulsiva)
+
+// Applica regole 2 e 3 se ci sono vicini
+void Movement::apply_neighbor_sums(const Boid& self, const NeighborSums& sums,
+                                   const Interaction& k, Velocity& v_i) const
+{
+  if (sums.count > 0) {
+    const Position center_mass{sums.pos_sum[0] / sums.count,
+                               sums.pos_sum[1] / sums.count};
+    const Velocity mean_vel{sums.vel_sum[0] / sums.count,
+                            sums.vel_sum[1] / sums.count};
+
+    add_inplace(v_i, rule2(self.vel, mean_vel, k.a));
+    add_inplace(v_i, rule3(self.pos, center_mass, k.c));
+  }
+}
+// Applica la forza del mouse (attrattiva o repulsiva), trattata come un
+// emettitore puntiforme
 void Movement::apply_mouse_force(const Boid& self, Velocity& v_i)
 {
   if (!mouse_force_active)
     return;
 
-  double dx      = mouse_pos.x - self.pos[0];
-  double dy      = mouse_pos.y - self.pos[1];
-  double dist_sq = dx * dx + dy * dy;
+  Emitter mouse;
+  mouse.a        = {mouse_pos.x, mouse_pos.y};
+  mouse.radius   = mouse_force_radius;
+  mouse.strength = mouse_pressed ? -mouse_force_strength : mouse_force_strength;
+  add_inplace(v_i, emitter_force(mouse, self.pos));
+}
+
+void Movement::set_force_field(const ForceField& f)
+{
+  forces = f;
+  forces.bin(arena.width, arena.height, force_cell);
+}
+
+const ForceField& Movement::get_force_field() const
+{
+  return forces;
+}
+
+void Movement::apply_field_force(const Boid& self, Velocity& v_i) const
+{
+  add_inplace(v_i, forces.force(self.pos));
+}
+
+void Movement::set_obstacles(const ObstacleField& field, double resolution)
+{
+  obstacles = field;
+  obstacles.bake(arena.width, arena.height, resolution, 2 * obstacle_margin);
+}
+
+const ObstacleField& Movement::get_obstacles() const
+{
+  return obstacles;
+}
+
+// Evita gli ostacoli risalendo il gradiente della distanza
+void Movement::apply_obstacle_force(const Boid& self, Velocity& v_i) const
+{
+  if (!obstacles.baked())
+    return;
+  Velocity grad;
+  const double dist = obstacles.sample(self.pos, grad);
+  const double norm = std::sqrt(grad[0] * grad[0] + grad[1] * grad[1]);
+  if (dist >= obstacle_margin || norm < 1e-9)
+    return;
+  // la spinta cresce avvicinandosi e resta limitata dentro l'ostacolo
+  const double push =
+      obstacle_strength * std::min(1. - dist / obstacle_margin, 2.);
+  v_i[0] += push * grad[0] / norm;
+  v_i[1] += push * grad[1] / norm;
+}
+
+void Movement::add_predator(const Boid& pr)
+{
+  predators.push_back(pr);
+}
+
+void Movement::remove_predator()
+{
+  if (predators.empty())
+    return;
+  predators.pop_back();
+  // la griglia non deve più contenere l'indice del predatore rimosso
+  if (predators.empty())
+    threat_cells.clear();
+  else
+    threat_cells.build(predators, flee_radius, false);
+}
+
+const std::vector<Boid>& Movement::get_predators() const
+{
+  return predators;
+}
+
+size_t Movement::nearest_prey(const Position& p) const
+{
+  return prey_cells.nearest(p);
+}
+
+// Fuga dai predatori entro flee_radius
+void Movement::apply_predator_force(const Boid& self, Velocity& v_i) const
+{
+  if (predators.empty())
+    return;
+  threat_cells.for_each_within(self.pos, flee_radius, [&](size_t k) {
+    const double dx   = self.pos[0] - predators[k].pos[0];
+    const double dy   = self.pos[1] - predators[k].pos[1];
+    const double dist = std::sqrt(dx * dx + dy * dy + 1e-6);
+    v_i[0] += flee_strength * dx / dist;
+    v_i[1] += flee_strength * dy / dist;
+  });
+}
 
-  if (dist_sq < mouse_force_radius * mouse_force_radius) {
-    double dist  = std::sqrt(dist_sq + 1e-6);
-    double fx    = dx / dist;
-    double fy    = dy / dist;
-    double force = mouse_pressed ? -mouse_force_strength : mouse_force_strength;
+// I predatori inseguono il boid più vicino e si muovono più lentamente
+void Movement::update_predators(double dt)
+{
+  for (Boid& pr : predators) {
+    const size_t j = nearest_prey(pr.pos);
+    if (j != CellGrid::npos)
+      add_inplace(pr.vel, rule3(pr.pos, boids[j].pos, chase_strength));
 
-    v_i[0] += force * fx;
-    v_i[1] += force * fy;
+    const double speed = get_speed(pr.vel);
+    if (speed > predator_max_speed) {
+      pr.vel[0] *= predator_max_speed / speed;
+      pr.vel[1] *= predator_max_speed / speed;
+    }
+    pr.pos[0] += pr.vel[0] * dt;
+    pr.pos[1] += pr.vel[1] * dt;
+    confine(pr.pos, pr.vel);
   }
 }
+
 // Aggiorna posizione e velocità dei boid
-void Movement::update_pos_vel(std::vector<Velocity>& vel_tot, double dt)
+void Movement::update_pos_vel(std::vector<Velocity>& vel_tot, double dt,
+                              const std::vector<Velocity>* drift)
+{
+  speeds.resize(n_b);
+  switch (boundary) {
+  case Boundary::periodic:
+    integrate<PeriodicBoundary>(vel_tot, drift, dt);
+    break;
+  case Boundary::reflective:
+    integrate<ReflectiveBoundary>(vel_tot, drift, dt);
+    break;
+  case Boundary::soft_margin:
+    integrate<SoftMarginBoundary>(vel_tot, drift, dt);
+    break;
+  }
+}
+
+template <class B>
+void Movement::integrate(std::vector<Velocity>& vel_tot,
+                         const std::vector<Velocity>* drift, double dt)
 {
   for (size_t i = 0; i < n_b; ++i) {
-    boids[i].pos[0] += vel_tot[i][0] * dt;
-    boids[i].pos[1] += vel_tot[i][1] * dt;
+    if constexpr (B::steers) {
+      B::steer(boids[i].pos, vel_tot[i], arena);
+      speeds[i] = static_cast<float>(limit_velocity(vel_tot[i]));
+    }
+    const Velocity& move = drift != nullptr ? (*drift)[i] : vel_tot[i];
+    boids[i].pos[0] += move[0] * dt;
+    boids[i].pos[1] += move[1] * dt;
     boids[i].vel = vel_tot[i];
-    check_sides(boids[i].pos);
+    B::confine(boids[i].pos, boids[i].vel, arena);
   }
 }
 
+// tutte le forze che agiscono sul boid i, poi il limite di velocità
+void Movement::apply_boid_forces(size_t i, Velocity& v_i)
+{
+  // nei frame delle metriche si calcolano tutti, per avere il grafo intero
+  if (sleeping_enabled && !metrics_frame && activity.sleeping(i))
+    return;
+  apply_neighbor_rules(i, v_i);
+  apply_mouse_force(boids[i], v_i);
+  apply_field_force(boids[i], v_i);
+  apply_predator_force(boids[i], v_i);
+  apply_obstacle_force(boids[i], v_i);
+  // ogni thread scrive soltanto i propri boids
+  const double speed = limit_velocity(v_i);
+  if (i < speeds.size())
+    speeds[i] = static_cast<float>(speed);
+}
+
+void Movement::set_threads(size_t n, int rebalance_every,
+                           double migration_cost)
+{
+  if (n == 0)
+    throw std::invalid_argument("Il numero di thread deve essere positivo");
+  balancer = LoadBalancer({arena.width, arena.height}, n, rebalance_every,
+                          migration_cost);
+  balancer.reset(boids);
+  scheduler = std::make_unique<TaskScheduler>(n);
+  n_threads = n;
+}
+
+const LoadBalancer& Movement::get_load_balancer() const
+{
+  return balancer;
+}
+
+void Movement::set_work_stealing(bool on)
+{
+  work_stealing = on;
+}
+
+TaskScheduler* Movement::get_scheduler() const
+{
+  return scheduler.get();
+}
+
+// ogni thread calcola i boids di una parte della partizione e ne misura il
+// tempo; le forze leggono soltanto lo stato comune, quindi basta che ogni
+// thread scriva le velocità dei propri boids
+void Movement::update_threaded(std::vector<Velocity>& vel_tot)
+{
+  const OrbPartition& part = balancer.partition();
+  std::vector<std::vector<size_t>> items(n_threads);
+  for (size_t i = 0; i < n_b; ++i)
+    items[part.owner(boids[i].pos)].push_back(i);
+
+  std::vector<double> seconds(n_threads, 0.);
+  scheduler->parallel_for(n_threads, [&](size_t p) {
+    const auto start = std::chrono::steady_clock::now();
+    for (const size_t i : items[p])
+      apply_boid_forces(i, vel_tot[i]);
+    seconds[p] = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  });
+  for (size_t p = 0; p < n_threads; ++p)
+    balancer.record(p, items[p].size(), seconds[p]);
+}
+
+// compiti per blocco di celle: un blocco affollato diventa più compiti, e i
+// thread rimasti senza lavoro li rubano a chi li ha ricevuti
+void Movement::update_work_stealing(std::vector<Velocity>& vel_tot)
+{
+  const auto nx = static_cast<size_t>(std::ceil(arena.width / task_block));
+  const auto ny = static_cast<size_t>(std::ceil(arena.height / task_block));
+  auto block_of = [&](const Position& p) {
+    const auto bx = static_cast<size_t>(std::max(p[0] / task_block, 0.));
+    const auto by = static_cast<size_t>(std::max(p[1] / task_block, 0.));
+    return std::min(by, ny - 1) * nx + std::min(bx, nx - 1);
+  };
+
+  // counting sort dei boids per blocco
+  std::vector<size_t> start(nx * ny + 1, 0);
+  for (size_t i = 0; i < n_b; ++i)
+    ++start[block_of(boids[i].pos) + 1];
+  for (size_t k = 0; k < nx * ny; ++k)
+    start[k + 1] += start[k];
+  std::vector<size_t> order(n_b);
+  std::vector<size_t> fill(start.begin(), start.end() - 1);
+  for (size_t i = 0; i < n_b; ++i)
+    order[fill[block_of(boids[i].pos)]++] = i;
+
+  std::vector<std::array<size_t, 2>> tasks;
+  for (size_t k = 0; k < nx * ny; ++k) {
+    for (size_t b = start[k]; b < start[k + 1]; b += max_task_boids)
+      tasks.push_back({b, std::min(b + max_task_boids, start[k + 1])});
+  }
+  scheduler->parallel_for(tasks.size(), [&](size_t t) {
+    for (size_t k = tasks[t][0]; k < tasks[t][1]; ++k)
+      apply_boid_forces(order[k], vel_tot[order[k]]);
+  });
+}
+
 // Aggiorna la posizione e la velocità dei boid ad ogni frame
 void Movement::update(int frame, double dt)
 {
   assert(frame >= 0);
+  // le metriche servono solo se questo frame invierà le statistiche
+  const bool want_metrics = metrics_enabled && n_b > 0 && stats_interval > 0.
+                         && time_accum + dt >= stats_interval;
+  const size_t n = substep_count(dt);
+  for (size_t k = 0; k < n; ++k) {
+    // il grafo è quello delle posizioni di inizio frame
+    metrics_frame = want_metrics && k == 0;
+    step(dt / static_cast<double>(n), 1. / static_cast<double>(n));
+  }
+  // metrics_frame è già stato consumato dal primo sottopasso
+  time_stats(frame, dt, want_metrics);
+}
+
+// un passo di durata h; le regole danno impulsi per frame, quindi in un
+// sottopasso la variazione di velocità viene pesata con weight
+void Movement::step(double h, double weight)
+{
+  build_index();
+  index_reach = max_speed * h; // spostamento massimo prima del prossimo
   if (n_b < 1) {
-    time_stats(frame, dt);
+    update_predators(h);
     return;
   }
 
+  if (metrics_frame) {
+    clusters.reset(n_b);
+    neighbor_count.assign(n_b, 0);
+  }
+  if (sleeping_enabled) {
+    if (mouse_force_active)
+      activity.wake_at({mouse_pos.x, mouse_pos.y}, mouse_force_radius);
+    for (const Boid& pr : predators)
+      activity.wake_at(pr.pos, flee_radius);
+    activity.begin_frame(boids);
+  }
+  std::vector<Velocity> vel_tot = target_velocities();
+  if (sleeping_enabled)
+    activity.end_frame(boids, vel_tot);
+  if (metrics_frame)
+    last_metrics = compute_metrics(boids, neighbor_count, clusters);
+  metrics_frame = false; // le valutazioni intermedie non contano
+
+  update_predators(h);
+  switch (integrator) {
+  case Integrator::explicit_euler:
+    advance<ExplicitEuler>(vel_tot, h, weight);
+    break;
+  case Integrator::semi_implicit_euler:
+    advance<SemiImplicitEuler>(vel_tot, h, weight);
+    break;
+  case Integrator::velocity_verlet:
+    advance<VelocityVerlet>(vel_tot, h, weight);
+    break;
+  case Integrator::rk2:
+    advance<Rk2>(vel_tot, h, weight);
+    break;
+  }
+  if (n_threads > 1 && !work_stealing)
+    balancer.end_frame(boids);
+}
+
+// velocità di ogni boid dopo le forze nello stato attuale (indice già
+// costruito)
+std::vector<Velocity> Movement::target_velocities()
+{
   std::vector<Velocity> vel_tot;
   for (const auto& bc : boids)
     vel_tot.push_back(bc.vel);
+  // i boids addormentati tengono la velocità, e quindi il modulo, di prima
+  speeds.resize(n_b);
 
-  for (size_t i = 0; i < n_b; ++i) {
-    apply_neighbor_rules(i, vel_tot[i]);
-    apply_mouse_force(boids[i], vel_tot[i]);
-    limit_velocity(vel_tot[i]);
+  if (n_threads > 1 && work_stealing) {
+    update_work_stealing(vel_tot);
+  } else if (n_threads > 1) {
+    update_threaded(vel_tot);
+  } else {
+    for (size_t i = 0; i < n_b; ++i)
+      apply_boid_forces(i, vel_tot[i]);
   }
-
-  update_pos_vel(vel_tot, dt);
-  time_stats(frame, dt);
+  return vel_tot;
 }
 
-// Stampa alcune statistiche (velocità media, distanza media, deviazione
-// standard e numero di boids)
-void Movement::print_stats(int frame) const
+// vel_tot arriva con le velocità dopo le forze nello stato iniziale; le
+// regole danno impulsi per frame, quindi in un sottopasso la variazione
+// viene pesata con weight
+template <class I>
+void Movement::advance(std::vector<Velocity>& vel_tot, double h,
+                       double weight)
 {
-  if (n_b < 2)
-    return;
-
-  std::vector<double> speeds(n_b);
-  double total_speed = 0.0;
-
+  std::vector<Velocity> dv(n_b);
   for (size_t i = 0; i < n_b; ++i) {
-    double v  = get_speed(boids[i].vel);
-    speeds[i] = v;
-    total_speed += v;
+    const Velocity& v = boids[i].vel;
+    dv[i]             = {weight * (vel_tot[i][0] - v[0]),
+                         weight * (vel_tot[i][1] - v[1])};
+    if (weight < 1.) {
+      vel_tot[i] = {v[0] + dv[i][0], v[1] + dv[i][1]};
+      speeds[i]  = static_cast<float>(get_speed(vel_tot[i]));
+    }
   }
-  double n_b2          = static_cast<double>(n_b);
-  double mean_speed    = total_speed / n_b2;
-  double speed_std_dev = 0.0;
-  for (double sp : speeds)
-    speed_std_dev += (sp - mean_speed) * (sp - mean_speed);
-  speed_std_dev = std::sqrt(speed_std_dev / n_b2);
 
-  std::vector<double> distances;
-  double total_distance = 0.0;
+  if constexpr (I::stage == IntegratorStage::midpoint) {
+    // stato a metà passo, poi si ripristina quello iniziale
+    const std::vector<Boid> start = boids;
+    for (size_t i = 0; i < n_b; ++i) {
+      Boid& bo = boids[i];
+      bo.pos[0] += bo.vel[0] * h / 2.;
+      bo.pos[1] += bo.vel[1] * h / 2.;
+      bo.vel[0] += dv[i][0] / 2.;
+      bo.vel[1] += dv[i][1] / 2.;
+    }
+    build_index();
+    const std::vector<Velocity> mid = target_velocities();
+    for (size_t i = 0; i < n_b; ++i) {
+      const Velocity& v_m = boids[i].vel;
+      const Velocity& v   = start[i].vel;
+      vel_tot[i] = {v[0] + weight * (mid[i][0] - v_m[0]),
+                    v[1] + weight * (mid[i][1] - v_m[1])};
+      speeds[i]  = static_cast<float>(limit_velocity(vel_tot[i]));
+    }
+    boids = start;
+    // l'indice è quello delle posizioni a metà passo, non di quelle di
+    // partenza: la vista ricostruisce la sua griglia
+    index_current = false;
+  }
 
-  for (size_t i = 0; i < n_b; ++i) {
-    for (size_t j = i + 1; j < n_b; ++j) {
-      double dx   = boids[i].pos[0] - boids[j].pos[0];
-      double dy   = boids[i].pos[1] - boids[j].pos[1];
-      double dist = std::sqrt(dx * dx + dy * dy);
-      distances.push_back(dist);
-      total_distance += dist;
+  if constexpr (I::drift == 1.) {
+    update_pos_vel(vel_tot, h);
+  } else {
+    std::vector<Velocity> drift(n_b);
+    for (size_t i = 0; i < n_b; ++i) {
+      const Velocity& v = boids[i].vel;
+      drift[i] = {v[0] + I::drift * dv[i][0], v[1] + I::drift * dv[i][1]};
+    }
+    update_pos_vel(vel_tot, h, &drift);
+  }
+
+  if constexpr (I::stage == IntegratorStage::corrector) {
+    // media tra la variazione iniziale e quella nella nuova posizione
+    build_index();
+    const std::vector<Velocity> end = target_velocities();
+    for (size_t i = 0; i < n_b; ++i) {
+      Velocity& v = boids[i].vel;
+      v[0] += (weight * (end[i][0] - v[0]) - dv[i][0]) / 2.;
+      v[1] += (weight * (end[i][1] - v[1]) - dv[i][1]) / 2.;
+      speeds[i] = static_cast<float>(limit_velocity(v));
     }
   }
+}
+
+void Movement::set_sleeping(bool on, double threshold, int frames)
+{
+  activity.configure(arena.width, arena.height, std::max(d, 16.), threshold,
+                     frames);
+  sleeping_enabled = on;
+}
+
+const ActivityTracker& Movement::get_activity() const
+{
+  return activity;
+}
 
-  int num_pairs        = static_cast<int>(distances.size());
-  double mean_distance = (num_pairs > 0) ? total_distance / num_pairs : 0.0;
+void Movement::set_integrator(Integrator kind)
+{
+  integrator = kind;
+}
 
-  double dist_std_dev = 0.0;
-  for (double dist : distances)
-    dist_std_dev += (dist - mean_distance) * (dist - mean_distance);
-  if (num_pairs > 0)
-    dist_std_dev = std::sqrt(dist_std_dev / num_pairs);
+Integrator Movement::get_integrator() const
+{
+  return integrator;
+}
 
-  std::cout << "Frame " << frame << " | Vel. media: " << mean_speed
-            << " | Dev. std. vel.: " << speed_std_dev
-            << " | Dist. media: " << mean_distance
-            << " | Dev. std. dist.: " << dist_std_dev << " | N_b: " << n_b
-            << '\n';
+void Movement::set_substepping(bool on, double fraction, size_t max_steps)
+{
+  if (fraction <= 0.)
+    throw std::invalid_argument(
+        "La frazione della distanza di separazione deve essere positiva");
+  if (max_steps == 0)
+    throw std::invalid_argument("Serve almeno un sottopasso");
+  substepping      = on;
+  substep_fraction = fraction;
+  max_substeps     = max_steps;
+}
+
+// abbastanza sottopassi perché il boid più veloce non percorra più di
+// substep_fraction * d_s in ognuno, così la separazione non viene saltata
+size_t Movement::substep_count(double dt) const
+{
+  if (!substepping || d_s <= 0. || dt <= 0.)
+    return 1;
+  double v2 = 0.;
+  for (const Boid& bo : boids)
+    v2 = std::max(v2, bo.vel[0] * bo.vel[0] + bo.vel[1] * bo.vel[1]);
+  for (const Boid& pr : predators)
+    v2 = std::max(v2, pr.vel[0] * pr.vel[0] + pr.vel[1] * pr.vel[1]);
+  const double steps = std::ceil(std::sqrt(v2) * dt / (substep_fraction * d_s));
+  if (steps >= static_cast<double>(max_substeps))
+    return max_substeps;
+  return std::max<size_t>(1, static_cast<size_t>(steps));
+}
+
+// Stampa alcune statistiche (velocità media, distanza media, deviazione
+// standard e numero di boids)
+void Movement::print_stats(int frame) const
+{
+  if (n_b < 2)
+    return;
+  bd::print_stats(std::cout, compute_stats(frame, boids));
 }
 // metodi riguardanti la grafica
 void Movement::draw_mouse(const sf::Vector2i& mouse_position,
@@ -294,4 +1052,45 @@ void Movement::draw_boids(const Position& p, const Velocity& v,
   shape.setPosition(static_cast<float>(p[0]), static_cast<float>(p[1]));
   window.draw(shape);
 }
+
+void Movement::draw_predator(const Position& p, sf::RenderWindow& window)
+{
+  sf::CircleShape shape(5.f);
+  shape.setOrigin(5.f, 5.f);
+  shape.setFillColor(sf::Color(255, 200, 0));
+  shape.setPosition(static_cast<float>(p[0]), static_cast<float>(p[1]));
+  window.draw(shape);
+}
+
+void Movement::draw_obstacles(sf::RenderWindow& window) const
+{
+  const sf::Color color(90, 90, 110);
+  for (const ObstacleField::Circle& ob : obstacles.get_circles()) {
+    const float r = static_cast<float>(ob.radius);
+    sf::CircleShape circle(r);
+    circle.setOrigin(r, r);
+    circle.setPosition(static_cast<float>(ob.center[0]),
+                       static_cast<float>(ob.center[1]));
+    circle.setFillColor(color);
+    window.draw(circle);
+  }
+  auto vertex = [&color](const Position& p) {
+    return sf::Vertex(
+        sf::Vector2f(static_cast<float>(p[0]), static_cast<float>(p[1])),
+        color);
+  };
+  for (const ObstacleField::Polygon& poly : obstacles.get_polygons()) {
+    sf::VertexArray outline(sf::LineStrip);
+    for (const Position& v : poly)
+      outline.append(vertex(v));
+    outline.append(vertex(poly.front()));
+    window.draw(outline);
+  }
+  sf::VertexArray walls(sf::Lines);
+  for (const ObstacleField::Wall& w : obstacles.get_walls()) {
+    walls.append(vertex(w.a));
+    walls.append(vertex(w.b));
+  }
+  window.draw(walls);
+}
 } // namespace bd
\ No newline at end of file
@@ -1,28 +1,39 @@
 #ifndef BOIDS_LOGIC_HPP
 #define BOIDS_LOGIC_HPP
 
+#include "activity.hpp"
+#include "boid.hpp"
+#include "boundary.hpp"
+#include "cell_grid.hpp"
+#include "force_field.hpp"
+#include "integrator.hpp"
+#include "load_balancer.hpp"
+#include "obstacle_field.hpp"
+#include "quadtree.hpp"
+#include "scheduler.hpp"
+#include "stats.hpp"
 #include <SFML/Graphics.hpp>
-#include <array>
+#include <memory>
 #include <vector>
 
 namespace bd {
-using Position = std::array<double, 2>;
-using Velocity = std::array<double, 2>;
 
-inline void add_inplace(std::array<double, 2>& i,
-                        const std::array<double, 2>& other)
+// strategia usata per trovare i vicini di ogni boid
+enum class NeighborSearch
 {
-  i[0] += other[0];
-  i[1] += other[1];
-}
+  brute_force, // confronto con tutti gli altri boids
+  barnes_hut,  // quadtree: i nodi lontani contano in blocco per regole 2 e 3
+  grid,        // griglia di celle di lato d, ricerca esatta
+  prefix_sum   // griglia fine con summed-area table per regole 2 e 3
+};
 
-struct Boid
+// coefficienti di separazione, allineamento e coesione tra due specie
+struct Interaction
 {
-  Position pos;
-  Velocity vel;
-  explicit Boid(double x_ = 0, double y_ = 0, double v_x_ = 0, double v_y_ = 0);
-}; // il primo elemento degli array riguarda le coordinate sulle x, il secondo
-   // sulle y
+  double s;
+  double a;
+  double c;
+};
 
 // classe con i metodi che definiscono i movimenti dei boids
 class Movement
@@ -35,29 +46,130 @@ class Movement
   double a;
   double c;
 
+  NeighborSearch search = NeighborSearch::brute_force;
+  double theta          = 0.5; // angolo di apertura per Barnes-Hut
+  QuadTree tree;
+  CellGrid cells;
+  double fov_cos = -1.; // coseno della semiampiezza del campo visivo
+  static constexpr int prefix_cells_per_d = 8; // finezza della griglia
+
+  std::vector<float> speeds; // vedi get_speeds
+
+  // selezione dei boids inquadrati: riusa la griglia dei vicini se è
+  // ancora quella dei boids attuali, allargando la ricerca di quanto un
+  // boid può essersi mosso dalla sua costruzione; altrimenti ne costruisce
+  // una propria con celle di lato view_cell
+  bool index_current  = false;
+  double index_reach  = 0.;
+  CellGrid view_cells;
+  std::vector<size_t> group_scratch;
+  static constexpr double view_cell = 128;
+
+  // matrice S x S (riga: specie del boid, colonna: specie del vicino), vuota
+  // con una sola specie; i boids sono ordinati per specie e species_start
+  // contiene l'inizio di ogni specie (S + 1 elementi)
+  std::vector<Interaction> species_matrix;
+  std::vector<size_t> species_start;
+
+  // predatori: usano lo stato di un boid ma inseguono la preda più vicina,
+  // mentre i boids fuggono quelli entro flee_radius
+  std::vector<Boid> predators;
+  CellGrid prey_cells;   // griglia dei boids per la preda più vicina
+  CellGrid threat_cells; // griglia dei predatori per le minacce vicine
+  static constexpr double flee_radius    = 100;
+  static constexpr double flee_strength  = 60;
+  static constexpr double chase_strength = 0.5;
+
+  // ostacoli statici, cotti in una griglia di distanze con segno
+  ObstacleField obstacles;
+  static constexpr double obstacle_margin   = 40; // distanza di reazione
+  static constexpr double obstacle_strength = 80;
+
+  // campi di forza attrattivi e repulsivi, suddivisi in celle di force_cell
+  ForceField forces;
+  static constexpr double force_cell = 64;
+
+  // aggiornamento su più thread, con i boids divisi tra i thread da una
+  // bisezione ORB che segue il costo misurato di ogni parte
+  size_t n_threads = 1;
+  LoadBalancer balancer;
+  // thread persistenti; con work_stealing i compiti sono blocchi di celle
+  // di lato task_block, spezzati oltre max_task_boids boids, invece delle
+  // parti dell'ORB
+  std::unique_ptr<TaskScheduler> scheduler;
+  bool work_stealing                     = false;
+  static constexpr double task_block     = 128;
+  static constexpr size_t max_task_boids = 256;
+
   sf::Vector2f mouse_pos;
   inline static bool mouse_pressed             = false;
   inline static bool mouse_force_active        = false;
   static constexpr int mouse_force_radius      = 80;
   static constexpr double mouse_force_strength = 40;
 
-  inline static double time_accum        = 0.0;
-  static constexpr double stats_interval = 1.0; // ogni quanti secondi stampare
+  // statistiche calcolate e stampate da un thread separato, creato alla
+  // prima richiesta
+  double time_accum     = 0.0;
+  double stats_interval = 1.0; // ogni quanti secondi stampare, 0 = mai
+  double stats_error    = 0.01; // errore relativo sulla distanza media
+  std::unique_ptr<StatsWorker> stats_worker;
+  // metriche dei gruppi raccolte solo nei frame che inviano le statistiche,
+  // unendo i lati del grafo dei vicini già visitati dall'update
+  bool metrics_enabled = true;
+  bool metrics_frame   = false;
+  ConcurrentUnionFind clusters;
+  std::vector<int> neighbor_count;
+  std::optional<FlockMetrics> last_metrics;
+
+  // bordi dell'arena; la modalità viene scelta una volta per frame e il
+  // ciclo di integrazione è istanziato per ogni politica
+  Boundary boundary = Boundary::periodic;
+  Arena arena;
+  template <class B>
+  void integrate(std::vector<Velocity>& vel_tot,
+                 const std::vector<Velocity>* drift, double dt);
+
+  // sottopassi adattivi, scelti a ogni frame dalla velocità massima
+  bool substepping        = false;
+  double substep_fraction = 0.5;
+  size_t max_substeps     = 16;
+  void step(double h, double weight);
+
+  // celle addormentate: i loro boids saltano le forze e proseguono a
+  // velocità costante
+  bool sleeping_enabled = false;
+  ActivityTracker activity;
+
+  // integratore scelto a ogni passo tra le politiche di integrator.hpp
+  Integrator integrator = Integrator::semi_implicit_euler;
+  std::vector<Velocity> target_velocities();
+  template <class I>
+  void advance(std::vector<Velocity>& vel_tot, double h, double weight);
+  void confine(Position& p, Velocity& v) const;
 
  public:
   static constexpr int max_speed     = 700;
   static constexpr int screen_width  = 1600;
   static constexpr int screen_height = 900;
-  static constexpr int edge        = 30;
+  static constexpr int edge          = 30;
+  static constexpr size_t max_species = 8;
+  static constexpr int predator_max_speed = 500;
 
+  // world_: dimensioni del mondo, di default quelle della finestra; bordi,
+  // partizione dei thread, campi di forza e ostacoli le seguono
   explicit Movement(const std::vector<Boid>& b_ = {}, double d_ = 0,
                     double d_s_ = 0, double s_ = 0, double a_ = 0,
-                    double c_ = 0);
+                    double c_ = 0,
+                    const Position& world_ = {screen_width, screen_height});
 
   void push_back_(const Boid& bo);
   void remove_();
 
   const std::vector<Boid>& get_boids() const;
+  Position get_world() const;
+  // modulo della velocità di ogni boid dopo l'ultimo update, salvato da
+  // limit_velocity durante le forze: il disegno non deve ricalcolarlo
+  const std::vector<float>& get_speeds() const;
   double get_speed(const Velocity& vel) const;
   double diff_pos2(const Position& pos_i, const Position& pos_j) const;
   bool is_neighbor(const Position& pos_i, const Position& pos_j) const;
@@ -66,9 +178,40 @@ class Movement
   Velocity rule1(const Position& pos_i, const Position& pos_j) const;
   Velocity rule2(const Velocity& vel_i, const Velocity& mean_vel) const;
   Velocity rule3(const Position& vel_i, const Position& center_mass) const;
+  // varianti con coefficiente esplicito, usate tra specie diverse
+  Velocity rule1(const Position& pos_i, const Position& pos_j,
+                 double s_) const;
+  Velocity rule2(const Velocity& vel_i, const Velocity& mean_vel,
+                 double a_) const;
+  Velocity rule3(const Position& pos_i, const Position& center_mass,
+                 double c_) const;
+
+  // più specie: matrix ha n_species * n_species coefficienti; i boids
+  // vengono riordinati per specie
+  void set_species(size_t n_species, const std::vector<Interaction>& matrix);
+  size_t n_species() const;
+  Interaction interaction(size_t s_i, size_t s_j) const;
 
+  void set_neighbor_search(NeighborSearch mode, double theta_ = 0.5);
+  // campo visivo comune in gradi (360 = visione completa); il campo di un
+  // singolo boid, se impostato, ha la precedenza
+  void set_field_of_view(double fov_degrees);
+  double view_cos(const Boid& b) const;
+  // ricostruisce la struttura di ricerca dei vicini (chiamato da update)
+  void build_index();
+
+  // indici dei boids dentro rect (ordinati per cella, non per indice)
+  void visible_boids(const sf::FloatRect& rect, std::vector<size_t>& out);
+  // baricentro dei boids entro r da p, se ce ne sono
+  std::optional<Position> group_center(const Position& p, double r);
+
+  // effetto pacman, indipendente dalla modalità dei bordi
   void check_sides(Position& i);
-  void limit_velocity(Velocity& v);
+  // margin e turn contano solo per Boundary::soft_margin
+  void set_boundary(Boundary mode, double margin = 100., double turn = 40.);
+  Boundary get_boundary() const;
+  // limita v a max_speed e ne restituisce il modulo finale
+  double limit_velocity(Velocity& v);
 
   void set_mouse_force(const sf::Vector2f& pos, bool pressed,
                        bool switch_mouse_force);
@@ -78,13 +221,66 @@ class Movement
   }
 
   void apply_neighbor_rules(size_t i, Velocity& v_i);
+  void apply_neighbor_sums(const Boid& self, const NeighborSums& sums,
+                           const Interaction& k, Velocity& v_i) const;
   void apply_mouse_force(const Boid& self, Velocity& v_i);
-  void update_pos_vel(std::vector<Velocity>& vel_tot, double dt);
 
-  void time_stats(const int frame, const double dt);
+  // copia gli emettitori e li assegna alle celle della finestra
+  void set_force_field(const ForceField& f);
+  const ForceField& get_force_field() const;
+  void apply_field_force(const Boid& self, Velocity& v_i) const;
+
+  // copia gli ostacoli e li cuoce con passo resolution sull'intera finestra
+  void set_obstacles(const ObstacleField& field, double resolution = 4.);
+  const ObstacleField& get_obstacles() const;
+  void apply_obstacle_force(const Boid& self, Velocity& v_i) const;
+
+  void add_predator(const Boid& pr);
+  void remove_predator();
+  const std::vector<Boid>& get_predators() const;
+  size_t nearest_prey(const Position& p) const;
+  void apply_predator_force(const Boid& self, Velocity& v_i) const;
+  void update_predators(double dt);
+  // sposta i boids con drift (se dato) o con vel_tot, e assegna vel_tot
+  void update_pos_vel(std::vector<Velocity>& vel_tot, double dt,
+                      const std::vector<Velocity>* drift = nullptr);
+
+  // n thread per update; la partizione viene ricalcolata ogni
+  // rebalance_every frame se conviene rispetto al costo di migrazione
+  void set_threads(size_t n, int rebalance_every = 30,
+                   double migration_cost = 1.);
+  const LoadBalancer& get_load_balancer() const;
+  void set_work_stealing(bool on);
+  TaskScheduler* get_scheduler() const;
+  void apply_boid_forces(size_t i, Velocity& v_i);
+  void update_threaded(std::vector<Velocity>& vel_tot);
+  void update_work_stealing(std::vector<Velocity>& vel_tot);
+
+  // with_metrics: last_metrics è stato raccolto in questo frame
+  void time_stats(const int frame, const double dt,
+                  bool with_metrics = false);
+  void set_stats_interval(double seconds);
+  double get_stats_interval() const;
+  // errore relativo ammesso sulla distanza media (confidenza 95%)
+  void set_stats_error(double rel_error);
+  // ultimo risultato pubblicato dal thread delle statistiche, se c'è
+  std::optional<FlockStats> poll_stats();
+  void set_flock_metrics(bool on);
+  // metriche dell'ultimo frame che le ha raccolte
+  const std::optional<FlockMetrics>& get_flock_metrics() const;
 
   // metodo principale
   void update(int frame, double dt);
+  // con on, update divide il frame in sottopassi così che nessun boid
+  // percorra più di fraction * d_s in un sottopasso (al più max_steps)
+  void set_substepping(bool on, double fraction = 0.5, size_t max_steps = 16);
+  size_t substep_count(double dt) const;
+  void set_integrator(Integrator kind);
+  Integrator get_integrator() const;
+  // threshold: variazione di velocità per frame sotto cui un boid è fermo;
+  // una cella dorme dopo frames frame fermi (celle di lato d)
+  void set_sleeping(bool on, double threshold = 1., int frames = 30);
+  const ActivityTracker& get_activity() const;
 
   void print_stats(int frame) const;
 
@@ -92,6 +288,8 @@ class Movement
                          const bool is_mouse_pressed, sf::RenderWindow& window);
   void draw_boids(const Position& p, const Velocity& v,
                   sf::RenderWindow& window) const;
+  static void draw_predator(const Position& p, sf::RenderWindow& window);
+  void draw_obstacles(sf::RenderWindow& window) const;
 };
 
 } // namespace bd
@@ -0,0 +1,96 @@
+#ifndef BOUNDARY_HPP
+#define BOUNDARY_HPP
+
+#include "boid.hpp"
+#include "rules.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace bd {
+
+enum class Boundary
+{
+  periodic,    // effetto pacman
+  reflective,  // pareti rigide, la velocità normale si inverte
+  soft_margin, // spinta verso l'interno entro margin dalle pareti
+};
+
+// arena rettangolare [0, width) x [0, height)
+struct Arena
+{
+  double width  = 0.;
+  double height = 0.;
+  double margin = 100.; // spessore della fascia di spinta (soft_margin)
+  double turn   = 40.;  // spinta massima, sulla parete
+};
+
+// Politiche di bordo: scelte come parametro di template dell'integrazione,
+// così nel ciclo sui boids non resta nessuna scelta sulla modalità.
+// steer corregge la velocità prima del passo, confine riporta la posizione
+// nell'arena dopo il passo.
+struct PeriodicBoundary
+{
+  static constexpr bool steers = false;
+
+  static void steer(const Position&, Velocity&, const Arena&) {}
+
+  static void confine(Position& p, Velocity&, const Arena& a)
+  {
+    wrap(p, Position{a.width, a.height});
+  }
+};
+
+struct ReflectiveBoundary
+{
+  static constexpr bool steers = false;
+
+  static void steer(const Position&, Velocity&, const Arena&) {}
+
+  // riflessione speculare sulla parete superata, poi un limite nel caso di
+  // passi più lunghi dell'arena
+  static void reflect(double& x, double& v, double len)
+  {
+    if (x < 0.) {
+      x = -x;
+      v = std::abs(v);
+    } else if (x >= len) {
+      x = 2. * len - x;
+      v = -std::abs(v);
+    }
+    x = std::clamp(x, 0., std::nextafter(len, 0.));
+  }
+
+  static void confine(Position& p, Velocity& v, const Arena& a)
+  {
+    reflect(p[0], v[0], a.width);
+    reflect(p[1], v[1], a.height);
+  }
+};
+
+struct SoftMarginBoundary
+{
+  static constexpr bool steers = true;
+
+  // spinta lineare nella profondità di penetrazione nella fascia
+  static double push(double x, double len, const Arena& a)
+  {
+    return a.turn
+         * (std::max(0., a.margin - x) - std::max(0., x - (len - a.margin)))
+         / a.margin;
+  }
+
+  static void steer(const Position& p, Velocity& v, const Arena& a)
+  {
+    v[0] += push(p[0], a.width, a);
+    v[1] += push(p[1], a.height, a);
+  }
+
+  // la fascia non garantisce il contenimento: chi la attraversa rimbalza
+  static void confine(Position& p, Velocity& v, const Arena& a)
+  {
+    ReflectiveBoundary::confine(p, v, a);
+  }
+};
+
+} // namespace bd
+#endif
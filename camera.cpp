@@ -0,0 +1,99 @@
+#include "camera.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace bd {
+
+Camera::Camera(const Position& world_, const Position& screen_,
+               double max_zoom_)
+    : world{world_}
+    , screen{screen_}
+    , center{world_[0] / 2., world_[1] / 2.}
+    , max_zoom{max_zoom_}
+{
+  if (world[0] <= 0. || world[1] <= 0. || screen[0] <= 0. || screen[1] <= 0.)
+    throw std::invalid_argument("Dimensioni della telecamera non valide");
+  if (max_zoom < 1.)
+    throw std::invalid_argument("Lo zoom massimo deve essere almeno 1");
+}
+
+double Camera::scale() const
+{
+  return std::min(screen[0] / world[0], screen[1] / world[1]) * zoom;
+}
+
+void Camera::clamp_center()
+{
+  // lungo un asse più corto dell'inquadratura il mondo resta centrato
+  for (size_t k = 0; k < 2; ++k) {
+    const double half = screen[k] / scale() / 2.;
+    center[k] = half * 2. >= world[k]
+                  ? world[k] / 2.
+                  : std::clamp(center[k], half, world[k] - half);
+  }
+}
+
+void Camera::pan(double dx, double dy)
+{
+  center[0] += dx / scale();
+  center[1] += dy / scale();
+  clamp_center();
+}
+
+void Camera::zoom_at(double factor, const Position& screen_point)
+{
+  if (!(factor > 0.))
+    throw std::invalid_argument("Il fattore di zoom deve essere positivo");
+  const Position fixed = to_world(screen_point);
+  zoom                 = std::clamp(zoom * factor, 1., max_zoom);
+  center[0] = fixed[0] - (screen_point[0] - screen[0] / 2.) / scale();
+  center[1] = fixed[1] - (screen_point[1] - screen[1] / 2.) / scale();
+  clamp_center();
+}
+
+void Camera::follow(const Position& target, double smoothing)
+{
+  const double k = std::clamp(smoothing, 0., 1.);
+  center[0] += (target[0] - center[0]) * k;
+  center[1] += (target[1] - center[1]) * k;
+  clamp_center();
+}
+
+void Camera::reset()
+{
+  zoom   = 1.;
+  center = {world[0] / 2., world[1] / 2.};
+}
+
+Position Camera::to_world(const Position& screen_point) const
+{
+  return {center[0] + (screen_point[0] - screen[0] / 2.) / scale(),
+          center[1] + (screen_point[1] - screen[1] / 2.) / scale()};
+}
+
+Position Camera::get_center() const
+{
+  return center;
+}
+
+double Camera::get_zoom() const
+{
+  return zoom;
+}
+
+sf::FloatRect Camera::visible_rect() const
+{
+  const double w = screen[0] / scale();
+  const double h = screen[1] / scale();
+  return sf::FloatRect(static_cast<float>(center[0] - w / 2.),
+                       static_cast<float>(center[1] - h / 2.),
+                       static_cast<float>(w), static_cast<float>(h));
+}
+
+sf::View Camera::view() const
+{
+  const sf::FloatRect r = visible_rect();
+  return sf::View(r);
+}
+
+} // namespace bd
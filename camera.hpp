@@ -0,0 +1,45 @@
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include "boid.hpp"
+#include <SFML/Graphics.hpp>
+
+namespace bd {
+
+// telecamera 2D sul mondo: con zoom 1 l'intero mondo entra nello schermo,
+// zoom maggiori ingrandiscono. Il centro viene tenuto in modo che la
+// regione inquadrata non esca dal mondo
+class Camera
+{
+  Position world;
+  Position screen;
+  Position center;
+  double zoom     = 1.;
+  double max_zoom;
+
+  double scale() const; // pixel dello schermo per unità del mondo
+  void clamp_center();
+
+ public:
+  Camera(const Position& world_, const Position& screen_,
+         double max_zoom_ = 32.);
+
+  // spostamento di (dx, dy) pixel dello schermo
+  void pan(double dx, double dy);
+  // moltiplica lo zoom per factor tenendo fermo il punto del mondo sotto
+  // screen_point
+  void zoom_at(double factor, const Position& screen_point);
+  // avvicina il centro a target della frazione smoothing (1 = subito)
+  void follow(const Position& target, double smoothing);
+  void reset();
+
+  Position to_world(const Position& screen_point) const;
+  Position get_center() const;
+  double get_zoom() const;
+  // regione del mondo inquadrata
+  sf::FloatRect visible_rect() const;
+  sf::View view() const;
+};
+
+} // namespace bd
+#endif
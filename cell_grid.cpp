@@ -0,0 +1,277 @@
+#include "cell_grid.hpp"
+#include <cassert>
+#include <cmath>
+
+namespace bd {
+
+void CellGrid::build(const std::vector<Boid>& b, double cell_size,
+                     bool with_sums)
+{
+  boids = &b;
+  cell_start.clear();
+  index.resize(b.size());
+  sat.clear();
+  if (b.empty())
+    return;
+
+  x0          = b[0].pos[0];
+  y0          = b[0].pos[1];
+  double x_1  = x0;
+  double y_1  = y0;
+  for (const Boid& bo : b) {
+    x0  = std::min(x0, bo.pos[0]);
+    y0  = std::min(y0, bo.pos[1]);
+    x_1 = std::max(x_1, bo.pos[0]);
+    y_1 = std::max(y_1, bo.pos[1]);
+  }
+  cell = cell_size > 0. ? cell_size : 1.;
+  while ((std::floor((x_1 - x0) / cell) + 1.)
+             * (std::floor((y_1 - y0) / cell) + 1.)
+         > static_cast<double>(max_cells))
+    cell *= 2.;
+  nx = static_cast<size_t>((x_1 - x0) / cell) + 1;
+  ny = static_cast<size_t>((y_1 - y0) / cell) + 1;
+
+  // counting sort degli indici per cella
+  std::vector<size_t> cell_of(b.size());
+  cell_start.assign(nx * ny + 1, 0);
+  for (size_t i = 0; i < b.size(); ++i) {
+    cell_of[i] = cell_y(b[i].pos[1]) * nx + cell_x(b[i].pos[0]);
+    ++cell_start[cell_of[i] + 1];
+  }
+  for (size_t c = 0; c < nx * ny; ++c)
+    cell_start[c + 1] += cell_start[c];
+  std::vector<size_t> fill(cell_start.begin(), cell_start.end() - 1);
+  for (size_t i = 0; i < b.size(); ++i)
+    index[fill[cell_of[i]]++] = i;
+
+  if (!with_sums)
+    return;
+
+  // summed-area table: sat(x, y) = somme delle celle [0, x) x [0, y)
+  const size_t w = nx + 1;
+  sat.assign(w * (ny + 1), NeighborSums{});
+  for (size_t cy = 0; cy < ny; ++cy) {
+    NeighborSums row;
+    for (size_t cx = 0; cx < nx; ++cx) {
+      const size_t c = cy * nx + cx;
+      for (size_t k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+        add_inplace(row.pos_sum, b[index[k]].pos);
+        add_inplace(row.vel_sum, b[index[k]].vel);
+        ++row.count;
+      }
+      NeighborSums& s = sat[(cy + 1) * w + cx + 1];
+      s               = sat[cy * w + cx + 1];
+      add_inplace(s, row);
+    }
+  }
+}
+
+void CellGrid::clear()
+{
+  cell_start.clear();
+  index.clear();
+  sat.clear();
+  boids = nullptr;
+}
+
+size_t CellGrid::cell_x(double x) const
+{
+  if (!(x > x0))
+    return 0;
+  return std::min(static_cast<size_t>((x - x0) / cell), nx - 1);
+}
+
+size_t CellGrid::cell_y(double y) const
+{
+  if (!(y > y0))
+    return 0;
+  return std::min(static_cast<size_t>((y - y0) / cell), ny - 1);
+}
+
+bool CellGrid::cell_inside(const Position& p, double d2, size_t cx,
+                           size_t cy) const
+{
+  const double xl = x0 + static_cast<double>(cx) * cell;
+  const double yl = y0 + static_cast<double>(cy) * cell;
+  const double fx =
+      std::max(std::fabs(p[0] - xl), std::fabs(p[0] - xl - cell));
+  const double fy =
+      std::max(std::fabs(p[1] - yl), std::fabs(p[1] - yl - cell));
+  return fx * fx + fy * fy < d2;
+}
+
+double CellGrid::cell_min_dist2(const Position& p, size_t cx, size_t cy) const
+{
+  const double xl = x0 + static_cast<double>(cx) * cell;
+  const double yl = y0 + static_cast<double>(cy) * cell;
+  const double dx = p[0] < xl ? xl - p[0] : std::max(p[0] - xl - cell, 0.);
+  const double dy = p[1] < yl ? yl - p[1] : std::max(p[1] - yl - cell, 0.);
+  return dx * dx + dy * dy;
+}
+
+bool CellGrid::cell_hidden(const Position& p, size_t cx, size_t cy,
+                           const Velocity& heading, double cos_half) const
+{
+  const double xl = x0 + static_cast<double>(cx) * cell - p[0];
+  const double yl = y0 + static_cast<double>(cy) * cell - p[1];
+  const std::array<Position, 4> corners{
+      {{xl, yl}, {xl + cell, yl}, {xl, yl + cell}, {xl + cell, yl + cell}}};
+  // campo visivo fino a 180 gradi: basta che la cella stia tutta dietro
+  // (il cono è contenuto nel semipiano davanti)
+  if (cos_half >= 0.) {
+    return std::all_of(corners.begin(), corners.end(), [&](const Position& r) {
+      return heading[0] * r[0] + heading[1] * r[1] < 0.;
+    });
+  }
+  // oltre 180 gradi la zona cieca è un cono convesso: la cella vi è
+  // contenuta se lo sono tutti i suoi vertici
+  return std::none_of(corners.begin(), corners.end(), [&](const Position& r) {
+    return in_view(heading, r, cos_half);
+  });
+}
+
+size_t CellGrid::nearest(const Position& p) const
+{
+  size_t best = npos;
+  if (cell_start.empty())
+    return best;
+  double best_d2   = 0.;
+  const size_t pcx = cell_x(p[0]);
+  const size_t pcy = cell_y(p[1]);
+  auto visit       = [&](size_t cx, size_t cy) {
+    const size_t c = cy * nx + cx;
+    for (size_t k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+      const Boid& other = (*boids)[index[k]];
+      const double ox   = other.pos[0] - p[0];
+      const double oy   = other.pos[1] - p[1];
+      const double d2   = ox * ox + oy * oy;
+      if (best == npos || d2 < best_d2) {
+        best    = index[k];
+        best_d2 = d2;
+      }
+    }
+  };
+
+  // l'anello k contiene le celle a distanza di Chebyshev k da quella di p:
+  // ci si ferma quando nessuna cella più esterna può essere più vicina
+  for (size_t k = 0; k < std::max(nx, ny); ++k) {
+    if (best != npos) {
+      const double reach = static_cast<double>(k - 1) * cell;
+      if (k > 0 && reach * reach >= best_d2)
+        break;
+    }
+    const size_t cx_0 = pcx >= k ? pcx - k : 0;
+    const size_t cy_0 = pcy >= k ? pcy - k : 0;
+    const size_t cx_1 = std::min(pcx + k, nx - 1);
+    const size_t cy_1 = std::min(pcy + k, ny - 1);
+    for (size_t cy = cy_0; cy <= cy_1; ++cy) {
+      if (cy + k == pcy || cy == pcy + k) {
+        for (size_t cx = cx_0; cx <= cx_1; ++cx)
+          visit(cx, cy);
+        continue;
+      }
+      if (pcx >= k)
+        visit(pcx - k, cy);
+      if (k > 0 && pcx + k < nx)
+        visit(pcx + k, cy);
+    }
+  }
+  return best;
+}
+
+NeighborSums CellGrid::box_sums(size_t cx0, size_t cy0, size_t cx1,
+                                size_t cy1) const
+{
+  assert(!sat.empty() && cx0 <= cx1 && cx1 <= nx && cy0 <= cy1 && cy1 <= ny);
+  const size_t w          = nx + 1;
+  const NeighborSums& s11 = sat[cy1 * w + cx1];
+  const NeighborSums& s01 = sat[cy1 * w + cx0];
+  const NeighborSums& s10 = sat[cy0 * w + cx1];
+  const NeighborSums& s00 = sat[cy0 * w + cx0];
+  NeighborSums res;
+  for (size_t k = 0; k < 2; ++k) {
+    res.pos_sum[k] = s11.pos_sum[k] - s01.pos_sum[k] - s10.pos_sum[k]
+                   + s00.pos_sum[k];
+    res.vel_sum[k] = s11.vel_sum[k] - s01.vel_sum[k] - s10.vel_sum[k]
+                   + s00.vel_sum[k];
+  }
+  res.count = s11.count - s01.count - s10.count + s00.count;
+  return res;
+}
+
+NeighborSums CellGrid::neighbor_sums(const Position& p, double d) const
+{
+  NeighborSums res;
+  if (cell_start.empty() || d <= 0.)
+    return res;
+  assert(!sat.empty());
+
+  const double d2   = d * d;
+  const size_t cx_0 = cell_x(p[0] - d);
+  const size_t cx_1 = cell_x(p[0] + d);
+  const size_t cy_0 = cell_y(p[1] - d);
+  const size_t cy_1 = cell_y(p[1] + d);
+
+  // righe consecutive con lo stesso intervallo di celle interne vengono
+  // sommate con un'unica interrogazione della tabella
+  size_t run_lo = 0;
+  size_t run_hi = 0;
+  size_t run_y  = cy_0;
+
+  for (size_t cy = cy_0; cy <= cy_1; ++cy) {
+    // intervallo [lo, hi) delle celle della riga interamente nel cerchio
+    const double yl = y0 + static_cast<double>(cy) * cell;
+    const double fy =
+        std::max(std::fabs(p[1] - yl), std::fabs(p[1] - yl - cell));
+    size_t lo       = cx_0;
+    size_t hi       = cx_0;
+    if (fy * fy < d2) {
+      const double w = std::sqrt(d2 - fy * fy);
+      lo = std::clamp(cell_x(p[0] - w) + 1, cx_0, cx_1 + 1);
+      hi = std::max(lo, std::min(cell_x(p[0] + w), cx_1 + 1));
+      while (lo > cx_0 && cell_inside(p, d2, lo - 1, cy))
+        --lo;
+      while (lo < hi && !cell_inside(p, d2, lo, cy))
+        ++lo;
+      while (hi <= cx_1 && cell_inside(p, d2, hi, cy))
+        ++hi;
+      while (hi > lo && !cell_inside(p, d2, hi - 1, cy))
+        --hi;
+      if (lo == hi)
+        lo = hi = cx_0;
+    }
+
+    if (lo != run_lo || hi != run_hi) {
+      if (run_lo < run_hi)
+        add_inplace(res, box_sums(run_lo, run_y, run_hi, cy));
+      run_lo = lo;
+      run_hi = hi;
+      run_y  = cy;
+    }
+
+    // celle sul bordo del cerchio: controllo esatto dei singoli boids
+    for (size_t cx = cx_0; cx <= cx_1; ++cx) {
+      if (cx >= lo && cx < hi)
+        continue;
+      if (cell_min_dist2(p, cx, cy) >= d2)
+        continue;
+      const size_t c = cy * nx + cx;
+      for (size_t k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+        const Boid& other = (*boids)[index[k]];
+        const double ox   = other.pos[0] - p[0];
+        const double oy   = other.pos[1] - p[1];
+        if (ox * ox + oy * oy < d2) {
+          add_inplace(res.pos_sum, other.pos);
+          add_inplace(res.vel_sum, other.vel);
+          ++res.count;
+        }
+      }
+    }
+  }
+  if (run_lo < run_hi)
+    add_inplace(res, box_sums(run_lo, run_y, run_hi, cy_1 + 1));
+  return res;
+}
+
+} // namespace bd
@@ -0,0 +1,130 @@
+#ifndef CELL_GRID_HPP
+#define CELL_GRID_HPP
+
+#include "boid.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// griglia uniforme di celle quadrate: gli indici dei boids sono ordinati per
+// cella (counting sort), così i boids di una cella sono contigui
+class CellGrid
+{
+  double x0   = 0.; // origine della griglia
+  double y0   = 0.;
+  double cell = 1.; // lato della cella
+  size_t nx   = 0;
+  size_t ny   = 0;
+
+  std::vector<size_t> cell_start; // nx * ny + 1 elementi
+  std::vector<size_t> index;      // indici dei boids ordinati per cella
+  // tabella delle somme cumulative (summed-area table) per cella,
+  // (nx + 1) * (ny + 1) elementi con riga e colonna iniziali nulle
+  std::vector<NeighborSums> sat;
+  const std::vector<Boid>* boids = nullptr;
+
+  // limite sul numero di celle, oltre il quale il lato viene aumentato
+  static constexpr size_t max_cells = size_t{1} << 20;
+
+  // vero se l'intera cella (cx, cy) è entro d da p
+  bool cell_inside(const Position& p, double d2, size_t cx, size_t cy) const;
+  double cell_min_dist2(const Position& p, size_t cx, size_t cy) const;
+
+ public:
+  // ricostruisce la griglia; con with_sums calcola anche la summed-area table
+  void build(const std::vector<Boid>& b, double cell_size, bool with_sums);
+  // svuota la griglia: nessuna ricerca visita più alcun indice
+  void clear();
+  bool empty() const
+  {
+    return cell_start.empty();
+  }
+  double cell_size() const
+  {
+    return cell;
+  }
+
+  size_t cell_x(double x) const;
+  size_t cell_y(double y) const;
+
+  // somme sulle celle [cx0, cx1) x [cy0, cy1) in O(1)
+  NeighborSums box_sums(size_t cx0, size_t cy0, size_t cx1, size_t cy1) const;
+
+  // somme dei boids entro d da p (p compreso): le celle interamente nel
+  // raggio si sommano con la summed-area table, solo quelle sul bordo del
+  // cerchio vengono controllate boid per boid
+  NeighborSums neighbor_sums(const Position& p, double d) const;
+
+  // indice del boid più vicino a p (npos se la griglia è vuota), cercato
+  // per anelli di celle concentrici a partire da quella di p
+  size_t nearest(const Position& p) const;
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  // visita esatta dei boids entro r da p, f riceve l'indice del boid; con
+  // cos_half > -1 visita solo i boids nel cono visivo orientato come
+  // heading, saltando le celle che ne restano interamente fuori
+  template <class F>
+  void for_each_within(const Position& p, double r, F&& f,
+                       const Velocity& heading = {},
+                       double cos_half = -1.) const;
+
+  // visita i boids delle celle [cx0, cx1] x [cy0, cy1] (estremi compresi),
+  // senza controllarne la posizione
+  template <class F>
+  void for_each_in_cells(size_t cx0, size_t cy0, size_t cx1, size_t cy1,
+                         F&& f) const;
+
+  // vero se la cella (cx, cy) è sicuramente fuori dal cono visivo
+  bool cell_hidden(const Position& p, size_t cx, size_t cy,
+                   const Velocity& heading, double cos_half) const;
+};
+
+template <class F>
+void CellGrid::for_each_within(const Position& p, double r, F&& f,
+                               const Velocity& heading, double cos_half) const
+{
+  if (cell_start.empty() || r <= 0.)
+    return;
+  const bool limited = cos_half > -1.;
+  const double r2    = r * r;
+  const size_t cx_0  = cell_x(p[0] - r);
+  const size_t cx_1  = cell_x(p[0] + r);
+  const size_t cy_0  = cell_y(p[1] - r);
+  const size_t cy_1  = cell_y(p[1] + r);
+  for (size_t cy = cy_0; cy <= cy_1; ++cy) {
+    for (size_t cx = cx_0; cx <= cx_1; ++cx) {
+      const size_t c = cy * nx + cx;
+      if (cell_start[c] == cell_start[c + 1]
+          || (limited && cell_hidden(p, cx, cy, heading, cos_half)))
+        continue;
+      for (size_t k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+        const Boid& other = (*boids)[index[k]];
+        const Position rel{other.pos[0] - p[0], other.pos[1] - p[1]};
+        if (rel[0] * rel[0] + rel[1] * rel[1] < r2
+            && (!limited || in_view(heading, rel, cos_half)))
+          f(index[k]);
+      }
+    }
+  }
+}
+
+template <class F>
+void CellGrid::for_each_in_cells(size_t cx0, size_t cy0, size_t cx1,
+                                 size_t cy1, F&& f) const
+{
+  if (cell_start.empty())
+    return;
+  for (size_t cy = cy0; cy <= std::min(cy1, ny - 1); ++cy) {
+    const size_t row = cy * nx;
+    // le celle di una riga sono contigue nell'indice ordinato
+    const size_t first = cell_start[row + std::min(cx0, nx - 1)];
+    const size_t last  = cell_start[row + std::min(cx1, nx - 1) + 1];
+    for (size_t k = first; k < last; ++k)
+      f(index[k]);
+  }
+}
+
+} // namespace bd
+#endif
@@ -0,0 +1,591 @@
+#include "config.hpp"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bd {
+
+namespace {
+
+std::string trim(std::string_view s)
+{
+  const size_t first = s.find_first_not_of(" \t\r");
+  if (first == std::string_view::npos)
+    return {};
+  const size_t last = s.find_last_not_of(" \t\r");
+  return std::string(s.substr(first, last - first + 1));
+}
+
+[[noreturn]] void bad_value(const std::string& key, const std::string& v)
+{
+  throw std::invalid_argument("Valore non valido per " + key + ": " + v);
+}
+
+double to_double(const std::string& key, const std::string& v)
+{
+  size_t used = 0;
+  double x    = 0.;
+  try {
+    x = std::stod(v, &used);
+  } catch (const std::exception&) {
+    bad_value(key, v);
+  }
+  if (used != v.size())
+    bad_value(key, v);
+  return x;
+}
+
+long long to_integer(const std::string& key, const std::string& v,
+                     long long lo, long long hi)
+{
+  size_t used = 0;
+  long long x = 0;
+  try {
+    x = std::stoll(v, &used);
+  } catch (const std::exception&) {
+    bad_value(key, v);
+  }
+  if (used != v.size() || x < lo || x > hi)
+    bad_value(key, v);
+  return x;
+}
+
+int to_int(const std::string& key, const std::string& v)
+{
+  return static_cast<int>(to_integer(key, v, std::numeric_limits<int>::min(),
+                                     std::numeric_limits<int>::max()));
+}
+
+// interi non negativi: un conteggio negativo è un errore, non un modulo
+size_t to_count(const std::string& key, const std::string& v)
+{
+  return static_cast<size_t>(
+      to_integer(key, v, 0, std::numeric_limits<long long>::max()));
+}
+
+unsigned to_unsigned(const std::string& key, const std::string& v)
+{
+  return static_cast<unsigned>(
+      to_integer(key, v, 0, std::numeric_limits<unsigned>::max()));
+}
+
+bool to_bool(const std::string& key, const std::string& v)
+{
+  if (v == "true")
+    return true;
+  if (v == "false")
+    return false;
+  bad_value(key, v);
+}
+
+// le virgolette sono facoltative
+std::string to_text(const std::string&, const std::string& v)
+{
+  if (v.size() >= 2 && v.front() == '"' && v.back() == '"')
+    return v.substr(1, v.size() - 2);
+  return v;
+}
+
+template <class E>
+E to_enum(const std::string& key, const std::string& v,
+          std::initializer_list<std::pair<std::string_view, E>> names)
+{
+  const std::string name = to_text(key, v);
+  for (const auto& [n, e] : names)
+    if (n == name)
+      return e;
+  bad_value(key, v);
+}
+
+ThreadingMode to_threading(const std::string& key, const std::string& v)
+{
+  return to_enum<ThreadingMode>(
+      key, v,
+      {{"serial", ThreadingMode::serial},
+       {"partition", ThreadingMode::partition},
+       {"work_stealing", ThreadingMode::work_stealing},
+       {"shared_memory", ThreadingMode::shared_memory},
+       {"sockets", ThreadingMode::sockets}});
+}
+
+Transport to_transport(const std::string& key, const std::string& v)
+{
+  return to_enum<Transport>(
+      key, v, {{"unix", Transport::unix_socket}, {"tcp", Transport::tcp}});
+}
+
+NeighborSearch to_search(const std::string& key, const std::string& v)
+{
+  return to_enum<NeighborSearch>(
+      key, v,
+      {{"brute_force", NeighborSearch::brute_force},
+       {"barnes_hut", NeighborSearch::barnes_hut},
+       {"grid", NeighborSearch::grid},
+       {"prefix_sum", NeighborSearch::prefix_sum}});
+}
+
+Boundary to_boundary(const std::string& key, const std::string& v)
+{
+  return to_enum<Boundary>(key, v,
+                           {{"periodic", Boundary::periodic},
+                            {"reflective", Boundary::reflective},
+                            {"soft_margin", Boundary::soft_margin}});
+}
+
+Integrator to_integrator(const std::string& key, const std::string& v)
+{
+  return to_enum<Integrator>(
+      key, v,
+      {{"explicit_euler", Integrator::explicit_euler},
+       {"semi_implicit_euler", Integrator::semi_implicit_euler},
+       {"velocity_verlet", Integrator::velocity_verlet},
+       {"rk2", Integrator::rk2}});
+}
+
+FrameFormat to_format(const std::string& key, const std::string& v)
+{
+  return to_enum<FrameFormat>(
+      key, v, {{"raw", FrameFormat::raw_rgb}, {"png", FrameFormat::png}});
+}
+
+Emitter::Falloff to_falloff(const std::string& key, const std::string& v)
+{
+  return to_enum<Emitter::Falloff>(
+      key, v,
+      {{"constant", Emitter::Falloff::constant},
+       {"linear", Emitter::Falloff::linear},
+       {"quadratic", Emitter::Falloff::quadratic}});
+}
+
+// "x, y, ...": elementi separati da virgole
+std::vector<std::string> to_list(const std::string& key, const std::string& v)
+{
+  const std::string text = to_text(key, v);
+  std::vector<std::string> items;
+  size_t first = 0;
+  while (true) {
+    const size_t comma = text.find(',', first);
+    items.push_back(trim(std::string_view(text).substr(first, comma - first)));
+    if (comma == std::string::npos)
+      return items;
+    first = comma + 1;
+  }
+}
+
+std::vector<double> to_numbers(const std::string& key,
+                               const std::vector<std::string>& items)
+{
+  std::vector<double> x;
+  x.reserve(items.size());
+  for (const std::string& item : items)
+    x.push_back(to_double(key, item));
+  return x;
+}
+
+// ogni riga aggiunge un ostacolo: "x, y, raggio", "ax, ay, bx, by" oppure
+// i vertici "x1, y1, x2, y2, ..."
+void add_circle(SimConfig& c, const std::string& key, const std::string& v)
+{
+  const std::vector<double> x = to_numbers(key, to_list(key, v));
+  if (x.size() != 3)
+    bad_value(key, v);
+  c.obstacles.add_circle({x[0], x[1]}, x[2]);
+}
+
+void add_wall(SimConfig& c, const std::string& key, const std::string& v)
+{
+  const std::vector<double> x = to_numbers(key, to_list(key, v));
+  if (x.size() != 4)
+    bad_value(key, v);
+  c.obstacles.add_wall({x[0], x[1]}, {x[2], x[3]});
+}
+
+void add_polygon(SimConfig& c, const std::string& key, const std::string& v)
+{
+  const std::vector<double> x = to_numbers(key, to_list(key, v));
+  if (x.size() % 2 != 0)
+    bad_value(key, v);
+  ObstacleField::Polygon poly;
+  for (size_t k = 0; k < x.size(); k += 2)
+    poly.push_back({x[k], x[k + 1]});
+  c.obstacles.add_polygon(poly);
+}
+
+// "ax, ay, [bx, by,] raggio, intensità[, attenuazione]"; gli angoli di una
+// regione vanno in qualsiasi ordine, ForceField::add li riordina
+void add_emitter(SimConfig& c, const std::string& key, const std::string& v,
+                 Emitter::Shape shape)
+{
+  std::vector<std::string> items = to_list(key, v);
+  const size_t n = shape == Emitter::Shape::point ? 4 : 6;
+  Emitter e;
+  e.shape = shape;
+  if (items.size() == n + 1) {
+    e.falloff = to_falloff(key, items.back());
+    items.pop_back();
+  }
+  if (items.size() != n)
+    bad_value(key, v);
+  const std::vector<double> x = to_numbers(key, items);
+  e.a                         = {x[0], x[1]};
+  if (n == 6)
+    e.b = {x[2], x[3]};
+  e.radius   = x[n - 2];
+  e.strength = x[n - 1];
+  c.forces.add(e);
+}
+
+using Setter =
+    std::function<void(SimConfig&, const std::string&, const std::string&)>;
+
+// assegna il membro con il valore letto da parse
+template <class T>
+Setter field(T SimConfig::*member,
+             T (*parse)(const std::string&, const std::string&))
+{
+  return [member, parse](SimConfig& c, const std::string& k,
+                         const std::string& v) { c.*member = parse(k, v); };
+}
+
+// un elemento per ogni parametro: il nome è quello del file
+const std::map<std::string, Setter, std::less<>>& setters()
+{
+  using C = SimConfig;
+  static const std::map<std::string, Setter, std::less<>> table{
+      {"flock.count", field(&C::n_boids, to_count)},
+      {"flock.d", field(&C::d, to_double)},
+      {"flock.d_s", field(&C::d_s, to_double)},
+      {"flock.s", field(&C::s, to_double)},
+      {"flock.a", field(&C::a, to_double)},
+      {"flock.c", field(&C::c, to_double)},
+      {"flock.seed", field(&C::seed, to_unsigned)},
+      {"flock.three_d", field(&C::three_d, to_bool)},
+      {"flock.fixed_point", field(&C::fixed_point, to_bool)},
+      {"species.count", field(&C::n_species, to_count)},
+      {"species.cross_s", field(&C::cross_s, to_double)},
+      {"species.cross_a", field(&C::cross_a, to_double)},
+      {"species.cross_c", field(&C::cross_c, to_double)},
+      {"predators.count", field(&C::n_predators, to_count)},
+      {"obstacles.circle", add_circle},
+      {"obstacles.wall", add_wall},
+      {"obstacles.polygon", add_polygon},
+      {"obstacles.resolution", field(&C::obstacle_resolution, to_double)},
+      {"forces.point",
+       [](C& c, const std::string& k, const std::string& v) {
+         add_emitter(c, k, v, Emitter::Shape::point);
+       }},
+      {"forces.line",
+       [](C& c, const std::string& k, const std::string& v) {
+         add_emitter(c, k, v, Emitter::Shape::line);
+       }},
+      {"forces.region",
+       [](C& c, const std::string& k, const std::string& v) {
+         add_emitter(c, k, v, Emitter::Shape::region);
+       }},
+      {"world.width", field(&C::world_width, to_double)},
+      {"world.height", field(&C::world_height, to_double)},
+      {"world.depth", field(&C::world_depth, to_double)},
+      {"window.width", field(&C::window_width, to_unsigned)},
+      {"window.height", field(&C::window_height, to_unsigned)},
+      {"window.fps", field(&C::fps, to_int)},
+      {"threads.mode", field(&C::threading, to_threading)},
+      {"threads.count", field(&C::n_threads, to_count)},
+      {"threads.rebalance_every", field(&C::rebalance_every, to_int)},
+      {"threads.migration_cost", field(&C::migration_cost, to_double)},
+      {"threads.transport", field(&C::transport, to_transport)},
+      {"neighbors.search", field(&C::search, to_search)},
+      {"neighbors.theta", field(&C::theta, to_double)},
+      {"neighbors.fov", field(&C::fov, to_double)},
+      {"motion.boundary", field(&C::boundary, to_boundary)},
+      {"motion.margin", field(&C::margin, to_double)},
+      {"motion.turn", field(&C::turn, to_double)},
+      {"motion.integrator", field(&C::integrator, to_integrator)},
+      {"motion.substepping", field(&C::substepping, to_bool)},
+      {"motion.substep_fraction", field(&C::substep_fraction, to_double)},
+      {"motion.max_substeps", field(&C::max_substeps, to_count)},
+      {"motion.sleeping", field(&C::sleeping, to_bool)},
+      {"motion.sleep_threshold", field(&C::sleep_threshold, to_double)},
+      {"motion.sleep_frames", field(&C::sleep_frames, to_int)},
+      {"stats.interval", field(&C::stats_interval, to_double)},
+      {"stats.error", field(&C::stats_error, to_double)},
+      {"stats.metrics", field(&C::metrics, to_bool)},
+      {"render.lod_threshold", field(&C::lod_threshold, to_count)},
+      {"record.headless", field(&C::headless, to_bool)},
+      {"record.frames", field(&C::frames, to_int)},
+      {"record.path", field(&C::record_path, to_text)},
+      {"record.stride", field(&C::record_stride, to_int)},
+      {"record.format", field(&C::record_format, to_format)},
+  };
+  return table;
+}
+
+// primo parametro, tra quelli impostati, che il modello di base ignora:
+// BasicMovement (3D e virgola fissa) ha solo le tre regole, la griglia e i
+// bordi periodici
+const char* ignored_by_basic_model(const SimConfig& cfg)
+{
+  const SimConfig def;
+  const std::initializer_list<std::pair<bool, const char*>> checks{
+      {cfg.n_species != def.n_species, "species.count"},
+      {cfg.n_predators != def.n_predators, "predators.count"},
+      {!cfg.obstacles.empty(), "obstacles"},
+      {!cfg.forces.empty(), "forces"},
+      {cfg.threading != def.threading, "threads.mode"},
+      {cfg.search != def.search, "neighbors.search"},
+      {cfg.fov != def.fov, "neighbors.fov"},
+      {cfg.boundary != def.boundary, "motion.boundary"},
+      {cfg.integrator != def.integrator, "motion.integrator"},
+      {cfg.substepping != def.substepping, "motion.substepping"},
+      {cfg.sleeping != def.sleeping, "motion.sleeping"},
+      // senza statistiche va bene: il modello di base non le stampa
+      {cfg.stats_interval > 0. && cfg.stats_interval != def.stats_interval,
+       "stats.interval"},
+      {cfg.stats_error != def.stats_error, "stats.error"},
+      {cfg.metrics != def.metrics, "stats.metrics"},
+      {cfg.lod_threshold != def.lod_threshold, "render.lod_threshold"},
+  };
+  for (const auto& [ignored, key] : checks)
+    if (ignored)
+      return key;
+  return nullptr;
+}
+
+} // namespace
+
+void set_option(SimConfig& cfg, const std::string& key,
+                const std::string& value)
+{
+  const auto it = setters().find(key);
+  if (it == setters().end())
+    throw std::invalid_argument("Parametro sconosciuto: " + key);
+  it->second(cfg, key, value);
+}
+
+void load_config(SimConfig& cfg, std::istream& in)
+{
+  std::string line;
+  std::string section;
+  for (int n = 1; std::getline(in, line); ++n) {
+    // un # fuori dalle virgolette apre un commento
+    bool quoted = false;
+    for (size_t k = 0; k < line.size(); ++k) {
+      if (line[k] == '"')
+        quoted = !quoted;
+      else if (line[k] == '#' && !quoted) {
+        line.resize(k);
+        break;
+      }
+    }
+    const std::string text = trim(line);
+    if (text.empty())
+      continue;
+    const std::string where = "riga " + std::to_string(n) + ": ";
+    if (text.front() == '[') {
+      if (text.back() != ']')
+        throw std::invalid_argument(where + "sezione non chiusa");
+      section = trim(std::string_view(text).substr(1, text.size() - 2));
+      continue;
+    }
+    const size_t eq = text.find('=');
+    if (eq == std::string::npos)
+      throw std::invalid_argument(where + "manca '='");
+    const std::string name = trim(std::string_view(text).substr(0, eq));
+    const std::string key  = section.empty() ? name : section + "." + name;
+    try {
+      set_option(cfg, key, trim(std::string_view(text).substr(eq + 1)));
+    } catch (const std::invalid_argument& e) {
+      throw std::invalid_argument(where + e.what());
+    }
+  }
+}
+
+void load_config_file(SimConfig& cfg, const std::string& path)
+{
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("Impossibile aprire " + path);
+  load_config(cfg, in);
+}
+
+SimConfig parse_command_line(int argc, const char* const argv[])
+{
+  SimConfig cfg;
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  // prima i file, così gli altri argomenti li sovrascrivono
+  for (size_t k = 0; k < args.size(); ++k) {
+    if (args[k] != "--config")
+      continue;
+    if (k + 1 == args.size())
+      throw std::invalid_argument("Manca il file dopo --config");
+    load_config_file(cfg, args[++k]);
+  }
+  for (size_t k = 0; k < args.size(); ++k) {
+    const std::string& arg = args[k];
+    if (arg == "--config") {
+      ++k;
+    } else if (arg == "--3d") {
+      cfg.three_d = true;
+    } else if (arg == "--headless") {
+      cfg.headless = true;
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      if (k + 1 == args.size())
+        throw std::invalid_argument("Manca il valore di " + arg);
+      set_option(cfg, arg.substr(2), args[++k]);
+    } else {
+      throw std::invalid_argument("Argomento non riconosciuto: " + arg);
+    }
+  }
+  return cfg;
+}
+
+void validate(const SimConfig& cfg)
+{
+  if (!(cfg.d > 0))
+    throw std::invalid_argument(
+        "La distanza di interazione deve essere positiva");
+  if (!(cfg.d_s > 0))
+    throw std::invalid_argument(
+        "La distanza di separazione deve essere positiva");
+  if (cfg.d_s > cfg.d)
+    throw std::invalid_argument("La distanza di separazione non può essere "
+                                "maggiore della distanza di interazione");
+  if (!(cfg.s >= 0))
+    throw std::invalid_argument(
+        "Il coefficiente di separazione deve essere positivo");
+  if (!(cfg.a >= 0 && cfg.a <= 1))
+    throw std::invalid_argument("Il coefficiente di allineamento deve essere "
+                                "un numero compreso tra 0 e 1");
+  if (!(cfg.c >= 0 && cfg.c <= 1))
+    throw std::invalid_argument(
+        "Il coefficiente di coesione deve essere compreso tra 0 e 1");
+
+  if (!(cfg.world_width > 0 && cfg.world_height > 0)
+      || (cfg.three_d && !(cfg.world_depth > 0)))
+    throw std::invalid_argument(
+        "Le dimensioni del mondo devono essere positive");
+  if (cfg.window_width == 0 || cfg.window_height == 0)
+    throw std::invalid_argument(
+        "Le dimensioni della finestra devono essere positive");
+  if (cfg.fps <= 0)
+    throw std::invalid_argument("Gli FPS devono essere positivi");
+  if (cfg.threading != ThreadingMode::serial && cfg.n_threads == 0)
+    throw std::invalid_argument("Il numero di thread deve essere positivo");
+  if (cfg.rebalance_every < 1 || !(cfg.migration_cost >= 0))
+    throw std::invalid_argument("Parametri del bilanciamento non validi");
+
+  if (cfg.n_species < 1 || cfg.n_species > Movement::max_species)
+    throw std::invalid_argument("Numero di specie non valido");
+  if (!(cfg.cross_s >= 0) || !(cfg.cross_a >= 0 && cfg.cross_a <= 1)
+      || !(cfg.cross_c >= 0 && cfg.cross_c <= 1))
+    throw std::invalid_argument(
+        "Coefficienti di interazione tra specie non validi");
+  if (!(cfg.obstacle_resolution > 0))
+    throw std::invalid_argument(
+        "Il passo della griglia degli ostacoli deve essere positivo");
+
+  if (!(cfg.theta >= 0))
+    throw std::invalid_argument("Theta non può essere negativo");
+  if (!(cfg.fov > 0 && cfg.fov <= 360))
+    throw std::invalid_argument(
+        "Il campo visivo deve essere compreso tra 0 e 360 gradi");
+  if (!(cfg.margin > 0)
+      || 2. * cfg.margin > std::min(cfg.world_width, cfg.world_height))
+    throw std::invalid_argument(
+        "Il margine deve essere positivo e minore di metà dell'arena");
+  if (!(cfg.turn >= 0))
+    throw std::invalid_argument("La spinta dai bordi non può essere negativa");
+  if (!(cfg.substep_fraction > 0))
+    throw std::invalid_argument(
+        "La frazione del sottopasso deve essere positiva");
+  if (cfg.max_substeps == 0)
+    throw std::invalid_argument("Serve almeno un sottopasso");
+  if (!(cfg.sleep_threshold >= 0))
+    throw std::invalid_argument("La soglia di attività non può essere "
+                                "negativa");
+  if (cfg.sleep_frames < 1)
+    throw std::invalid_argument("Serve almeno un frame di quiete");
+  if (!(cfg.stats_interval >= 0))
+    throw std::invalid_argument(
+        "L'intervallo delle statistiche non può essere negativo");
+  if (!(cfg.stats_error > 0 && cfg.stats_error < 1))
+    throw std::invalid_argument(
+        "L'errore relativo deve essere compreso tra 0 e 1");
+
+  if (cfg.headless && cfg.frames < 1)
+    throw std::invalid_argument("Il numero di frame deve essere positivo");
+  if (cfg.record_stride < 1)
+    throw std::invalid_argument("Il passo di registrazione deve essere "
+                                "almeno 1");
+  if (cfg.three_d && (cfg.headless || !cfg.record_path.empty()))
+    throw std::invalid_argument(
+        "La simulazione 3D non si può registrare né eseguire senza finestra");
+  if (cfg.three_d) {
+    if (const char* key = ignored_by_basic_model(cfg))
+      throw std::invalid_argument(std::string(key)
+                                  + " non è supportato in 3D");
+  }
+  if (cfg.fixed_point) {
+    if (!cfg.headless || !cfg.record_path.empty())
+      throw std::invalid_argument("La virgola fissa si esegue solo senza "
+                                  "finestra e senza registrazione");
+    if (const char* key = ignored_by_basic_model(cfg))
+      throw std::invalid_argument(std::string(key)
+                                  + " non è supportato in virgola fissa");
+  }
+
+  // i processi delle strisce conoscono solo d, d_s, s, a, c e il mondo
+  if (cfg.threading == ThreadingMode::shared_memory
+      || cfg.threading == ThreadingMode::sockets) {
+    if (!cfg.headless || !cfg.record_path.empty())
+      throw std::invalid_argument("Le strisce su processi separati si "
+                                  "eseguono solo senza finestra e senza "
+                                  "registrazione");
+    if (cfg.n_species > 1 || cfg.n_predators > 0 || !cfg.obstacles.empty()
+        || !cfg.forces.empty() || cfg.boundary != Boundary::periodic)
+      throw std::invalid_argument(
+          "Le strisce su processi separati usano solo il modello di base");
+  }
+}
+
+const char* config_usage()
+{
+  return "uso: boids_sim [--config <file>] [--3d] [--headless]\n"
+         "               [--<sezione.nome> <valore> ...]\n"
+         "parametri (nel file: nome = valore sotto [sezione]):\n"
+         "  flock.count d d_s s a c seed three_d fixed_point\n"
+         "  species.count cross_s cross_a cross_c\n"
+         "  predators.count\n"
+         "  obstacles.circle \"x, y, r\"  wall \"ax, ay, bx, by\"\n"
+         "            polygon \"x1, y1, x2, y2, ...\"  resolution\n"
+         "  forces.point \"x, y, radius, strength[, falloff]\"\n"
+         "         line|region \"ax, ay, bx, by, radius, strength"
+         "[, falloff]\"\n"
+         "         (falloff: constant|linear|quadratic; una riga per "
+         "elemento)\n"
+         "  world.width height depth\n"
+         "  window.width height fps\n"
+         "  threads.mode (serial|partition|work_stealing|\n"
+         "                shared_memory|sockets) count rebalance_every\n"
+         "          migration_cost transport (unix|tcp)\n"
+         "  neighbors.search (brute_force|barnes_hut|grid|prefix_sum) "
+         "theta fov\n"
+         "  motion.boundary (periodic|reflective|soft_margin) margin turn\n"
+         "         integrator (explicit_euler|semi_implicit_euler|\n"
+         "                     velocity_verlet|rk2)\n"
+         "         substepping substep_fraction max_substeps\n"
+         "         sleeping sleep_threshold sleep_frames\n"
+         "  stats.interval error metrics\n"
+         "  render.lod_threshold\n"
+         "  record.headless frames path stride format (raw|png)\n"
+         "con --3d e flock.fixed_point valgono solo flock, world, window e\n"
+         "stats.interval = 0\n";
+}
+
+} // namespace bd
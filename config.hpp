@@ -0,0 +1,117 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include "boids_logic.hpp"
+#include "force_field.hpp"
+#include "obstacle_field.hpp"
+#include "recorder.hpp"
+#include "socket_transport.hpp"
+#include <cstddef>
+#include <istream>
+#include <string>
+
+namespace bd {
+
+// come vengono distribuite le forze tra i thread
+enum class ThreadingMode
+{
+  serial,        // un solo thread
+  partition,     // bisezione ORB bilanciata sul costo misurato
+  work_stealing, // blocchi di celle rubati dai thread liberi
+  // strisce del mondo su processi separati, solo senza finestra e con il
+  // modello di base
+  shared_memory, // anelli in memoria condivisa
+  sockets        // socket locali o TCP (threads.transport)
+};
+
+// tutti i parametri di una simulazione, con i valori predefiniti
+struct SimConfig
+{
+  // stormo
+  size_t n_boids   = 500;
+  double d         = 60.;
+  double d_s       = 20.;
+  double s         = 1.5;
+  double a         = 0.04;
+  double c         = 0.3;
+  unsigned seed    = 0; // 0 = seme casuale
+  bool three_d     = false;
+  bool fixed_point = false; // modello di base in virgola fissa, senza finestra
+
+  // specie assegnate a turno ai boids: tra boids della stessa specie valgono
+  // s, a, c, tra specie diverse i coefficienti cross
+  size_t n_species   = 1;
+  double cross_s     = 1.5;
+  double cross_a     = 0.;
+  double cross_c     = 0.;
+  size_t n_predators = 0; // in posizioni casuali
+
+  // ostacoli e sorgenti di forza, una riga del file per ciascuno
+  ObstacleField obstacles;
+  double obstacle_resolution = 4.;
+  ForceField forces;
+
+  // mondo e finestra
+  double world_width     = Movement::screen_width;
+  double world_height    = Movement::screen_height;
+  double world_depth     = 900.; // solo in 3D
+  unsigned window_width  = Movement::screen_width;
+  unsigned window_height = Movement::screen_height;
+  int fps                = 90;
+
+  // simulazione
+  ThreadingMode threading = ThreadingMode::serial;
+  size_t n_threads        = 4;
+  int rebalance_every     = 30;
+  double migration_cost   = 1.;
+  Transport transport     = Transport::unix_socket;
+  NeighborSearch search   = NeighborSearch::brute_force;
+  double theta            = 0.5;
+  double fov              = 360.;
+  Boundary boundary       = Boundary::periodic;
+  double margin           = 100.; // solo soft_margin
+  double turn             = 40.;
+  Integrator integrator   = Integrator::semi_implicit_euler;
+  bool substepping        = false;
+  double substep_fraction = 0.5;
+  size_t max_substeps     = 16;
+  bool sleeping           = false;
+  double sleep_threshold  = 1.;
+  int sleep_frames        = 30;
+
+  // statistiche
+  double stats_interval = 1.; // secondi, 0 = mai
+  double stats_error    = 0.01;
+  bool metrics          = true;
+
+  // disegno e registrazione
+  size_t lod_threshold      = 50000;
+  bool headless             = false;
+  int frames                = 600; // frame simulati senza finestra
+  std::string record_path;         // vuoto = nessuna registrazione
+  int record_stride         = 1;
+  FrameFormat record_format = FrameFormat::raw_rgb;
+};
+
+// assegna un parametro, con chiave "sezione.nome" come nel file
+void set_option(SimConfig& cfg, const std::string& key,
+                const std::string& value);
+
+// file in un sottoinsieme di TOML: righe "nome = valore" sotto intestazioni
+// "[sezione]", commenti con #, stringhe tra virgolette, numeri e booleani
+void load_config(SimConfig& cfg, std::istream& in);
+void load_config_file(SimConfig& cfg, const std::string& path);
+
+// argomenti: --config <file> (applicato per primo), --<sezione.nome>
+// <valore> per ogni parametro, --3d e --headless come abbreviazioni
+SimConfig parse_command_line(int argc, const char* const argv[]);
+
+// stessi controlli dei valori letti un tempo da std::cin, più quelli sui
+// nuovi parametri
+void validate(const SimConfig& cfg);
+
+// elenco dei parametri per --help
+const char* config_usage();
+
+} // namespace bd
+#endif
@@ -0,0 +1,310 @@
+#include "domain.hpp"
+#include "boids_logic.hpp"
+#include "shm_ring.hpp"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace bd {
+
+StripPartition::StripPartition(size_t n_strips, double width)
+{
+  if (n_strips == 0 || width <= 0.)
+    throw std::invalid_argument("Suddivisione in strisce non valida");
+  for (size_t r = 0; r <= n_strips; ++r)
+    cuts.push_back(width * static_cast<double>(r)
+                   / static_cast<double>(n_strips));
+}
+
+size_t StripPartition::size() const
+{
+  return cuts.size() - 1;
+}
+
+double StripPartition::lo(size_t r) const
+{
+  assert(r < size());
+  return cuts[r];
+}
+
+double StripPartition::hi(size_t r) const
+{
+  assert(r < size());
+  return cuts[r + 1];
+}
+
+double StripPartition::min_width() const
+{
+  double w = cuts.back();
+  for (size_t r = 0; r < size(); ++r)
+    w = std::min(w, hi(r) - lo(r));
+  return w;
+}
+
+size_t StripPartition::owner(double x) const
+{
+  const auto it = std::upper_bound(cuts.begin() + 1, cuts.end() - 1, x);
+  return static_cast<size_t>(it - (cuts.begin() + 1));
+}
+
+size_t StripPartition::left(size_t r) const
+{
+  return (r + size() - 1) % size();
+}
+
+size_t StripPartition::right(size_t r) const
+{
+  return (r + 1) % size();
+}
+
+DomainWorker::DomainWorker(size_t rank_, const StripPartition& part_,
+                           const std::vector<Boid>& b, double d_, double d_s_,
+                           double s_, double a_, double c_,
+                           const Position& world_)
+    : rank{rank_}
+    , part{part_}
+    , world{world_}
+    , d{d_}
+    , d_s{d_s_}
+    , s{s_}
+    , a{a_}
+    , c{c_}
+{
+  assert(rank < part.size());
+  for (const Boid& bo : b) {
+    if (part.owner(bo.pos[0]) == rank)
+      owned.push_back(bo);
+  }
+}
+
+size_t DomainWorker::get_rank() const
+{
+  return rank;
+}
+
+const std::vector<Boid>& DomainWorker::get_owned() const
+{
+  return owned;
+}
+
+void DomainWorker::collect_halo(std::vector<Boid>& to_left,
+                                std::vector<Boid>& to_right) const
+{
+  to_left.clear();
+  to_right.clear();
+  const bool first = rank == 0;
+  const bool last  = rank + 1 == part.size();
+  for (const Boid& bo : owned) {
+    if (!first && bo.pos[0] < part.lo(rank) + d)
+      to_left.push_back(bo);
+    if (!last && bo.pos[0] >= part.hi(rank) - d)
+      to_right.push_back(bo);
+  }
+}
+
+bool DomainWorker::needs_halo(const Boid& bo) const
+{
+  return (rank != 0 && bo.pos[0] < part.lo(rank) + d)
+      || (rank + 1 != part.size() && bo.pos[0] >= part.hi(rank) - d);
+}
+
+void DomainWorker::step(const std::vector<Boid>& halo, double dt)
+{
+  begin_step();
+  finish_step(halo, dt);
+}
+
+void DomainWorker::begin_step()
+{
+  new_vel.assign(owned.size(), Velocity{});
+  done.assign(owned.size(), false);
+  Movement mov(owned, d, d_s, s, a, c, world);
+  mov.set_neighbor_search(NeighborSearch::grid);
+  mov.build_index();
+  for (size_t i = 0; i < owned.size(); ++i) {
+    if (needs_halo(owned[i]))
+      continue;
+    new_vel[i] = owned[i].vel;
+    mov.apply_neighbor_rules(i, new_vel[i]);
+    mov.limit_velocity(new_vel[i]);
+    done[i] = true;
+  }
+}
+
+// i boids propri vengono prima dell'alone, così i loro indici non cambiano
+void DomainWorker::finish_step(const std::vector<Boid>& halo, double dt)
+{
+  assert(new_vel.size() == owned.size());
+  std::vector<Boid> local = owned;
+  local.insert(local.end(), halo.begin(), halo.end());
+  Movement mov(local, d, d_s, s, a, c, world);
+  mov.set_neighbor_search(NeighborSearch::grid);
+  mov.build_index();
+  for (size_t i = 0; i < owned.size(); ++i) {
+    if (!done[i]) {
+      new_vel[i] = owned[i].vel;
+      mov.apply_neighbor_rules(i, new_vel[i]);
+      mov.limit_velocity(new_vel[i]);
+    }
+  }
+  for (size_t i = 0; i < owned.size(); ++i) {
+    owned[i].pos[0] += new_vel[i][0] * dt;
+    owned[i].pos[1] += new_vel[i][1] * dt;
+    owned[i].vel = new_vel[i];
+    mov.check_sides(owned[i].pos);
+  }
+  new_vel.clear();
+}
+
+void DomainWorker::collect_migrants(std::vector<Boid>& to_left,
+                                    std::vector<Boid>& to_right)
+{
+  to_left.clear();
+  to_right.clear();
+  std::vector<Boid> kept;
+  for (const Boid& bo : owned) {
+    const size_t o = part.owner(bo.pos[0]);
+    if (o == rank)
+      kept.push_back(bo);
+    else if (o == part.left(rank))
+      to_left.push_back(bo);
+    else if (o == part.right(rank))
+      to_right.push_back(bo);
+    else
+      throw std::runtime_error("Un boid ha superato più di una striscia in "
+                               "un frame");
+  }
+  owned.swap(kept);
+}
+
+void DomainWorker::receive(const std::vector<Boid>& migrants)
+{
+  owned.insert(owned.end(), migrants.begin(), migrants.end());
+}
+
+namespace {
+void send(ShmRing& ring, const std::vector<Boid>& v)
+{
+  for (const Boid& bo : v)
+    ring.push({bo, false});
+  ring.push({Boid{}, true});
+}
+
+void receive_block(ShmRing& ring, std::vector<Boid>& v)
+{
+  for (Message m = ring.pop(); !m.last; m = ring.pop())
+    v.push_back(m.boid);
+}
+
+// to_left[r] va da r alla striscia a sinistra, to_right[r] a quella a
+// destra; ogni frame su ciascuna coda passano un blocco di alone e uno di
+// migranti, chiusi da un messaggio con last
+void run_worker(DomainWorker& w, std::vector<ShmRing>& to_left,
+                std::vector<ShmRing>& to_right, const StripPartition& part,
+                int frames, double dt)
+{
+  const size_t r = w.get_rank();
+  std::vector<Boid> out_left;
+  std::vector<Boid> out_right;
+  std::vector<Boid> in;
+  for (int f = 0; f < frames; ++f) {
+    w.collect_halo(out_left, out_right);
+    send(to_left[r], out_left);
+    send(to_right[r], out_right);
+    in.clear();
+    receive_block(to_right[part.left(r)], in);
+    receive_block(to_left[part.right(r)], in);
+    w.step(in, dt);
+
+    w.collect_migrants(out_left, out_right);
+    send(to_left[r], out_left);
+    send(to_right[r], out_right);
+    in.clear();
+    receive_block(to_right[part.left(r)], in);
+    receive_block(to_left[part.right(r)], in);
+    w.receive(in);
+  }
+}
+} // namespace
+
+std::vector<Boid> run_shared_memory(const std::vector<Boid>& b,
+                                    size_t n_workers, int frames, double dt,
+                                    double d, double d_s, double s, double a,
+                                    double c, const Position& world)
+{
+  if (frames < 0)
+    throw std::invalid_argument("Numero di frame non valido");
+  const StripPartition part(n_workers, world[0]);
+  if (part.min_width() < d)
+    throw std::invalid_argument("Le strisce devono essere larghe almeno "
+                                "quanto la distanza di interazione");
+
+  // in coda ci sono al massimo i migranti di un frame e l'alone del
+  // successivo, quindi push non resta mai in attesa di un vicino bloccato.
+  // Ogni processo invia prima di ricevere: con code più piccole due vicini
+  // che si inviano blocchi pieni si attenderebbero a vicenda. Alone e
+  // migranti non hanno un limite più stretto dell'intero stormo, perché
+  // tutti i boids possono raccogliersi nella stessa striscia, quindi le
+  // code sono dimensionate su b.size()
+  const size_t cap = 2 * b.size() + 4;
+  std::vector<ShmRing> to_left;
+  std::vector<ShmRing> to_right;
+  std::vector<ShmRing> result;
+  for (size_t r = 0; r < n_workers; ++r) {
+    to_left.emplace_back(cap);
+    to_right.emplace_back(cap);
+    result.emplace_back(b.size() + 1);
+  }
+  auto close_all = [&]() {
+    for (size_t r = 0; r < n_workers; ++r) {
+      to_left[r].close();
+      to_right[r].close();
+      result[r].close();
+    }
+  };
+
+  std::vector<pid_t> pids;
+  for (size_t r = 0; r < n_workers; ++r) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      close_all();
+      break;
+    }
+    if (pid == 0) {
+      int status = 0;
+      try {
+        DomainWorker w(r, part, b, d, d_s, s, a, c, world);
+        run_worker(w, to_left, to_right, part, frames, dt);
+        send(result[r], w.get_owned());
+      } catch (...) {
+        close_all();
+        status = 1;
+      }
+      _exit(status);
+    }
+    pids.push_back(pid);
+  }
+
+  std::vector<Boid> res;
+  bool ok = pids.size() == n_workers;
+  try {
+    for (size_t r = 0; ok && r < n_workers; ++r)
+      receive_block(result[r], res);
+  } catch (const std::runtime_error&) {
+    ok = false;
+  }
+  for (const pid_t pid : pids) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      ok = false;
+  }
+  if (!ok)
+    throw std::runtime_error("Un processo della simulazione distribuita è "
+                             "terminato con errore");
+  return res;
+}
+
+} // namespace bd
@@ -0,0 +1,85 @@
+#ifndef DOMAIN_HPP
+#define DOMAIN_HPP
+
+#include "boid.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// suddivisione del mondo in strisce verticali, una per processo: la striscia
+// r copre [lo(r), hi(r)) sull'asse x
+class StripPartition
+{
+  std::vector<double> cuts; // size() + 1 bordi, dal primo a 0 all'ultimo
+
+ public:
+  // n_strips strisce uguali su [0, width)
+  StripPartition(size_t n_strips, double width);
+
+  size_t size() const;
+  double lo(size_t r) const;
+  double hi(size_t r) const;
+  double min_width() const;
+  // striscia che contiene x (x già riportato dentro il mondo)
+  size_t owner(double x) const;
+  // strisce vicine, con l'effetto pacman tra la prima e l'ultima
+  size_t left(size_t r) const;
+  size_t right(size_t r) const;
+};
+
+// stato di un processo: i boids della sua striscia e i passi del frame, che
+// non dipendono dal mezzo usato per scambiare i boids con i vicini
+class DomainWorker
+{
+  size_t rank;
+  StripPartition part;
+  Position world; // dimensioni del mondo, per l'effetto pacman
+  std::vector<Boid> owned;
+  std::vector<Velocity> new_vel; // velocità del frame in corso
+  std::vector<bool> done;        // boids già calcolati senza alone
+  double d;
+  double d_s;
+  double s;
+  double a;
+  double c;
+
+ public:
+  // tiene solo i boids di b che cadono nella striscia rank; le strisce di
+  // part_ devono coprire la larghezza di world_
+  DomainWorker(size_t rank_, const StripPartition& part_,
+               const std::vector<Boid>& b, double d_, double d_s_, double s_,
+               double a_, double c_, const Position& world_);
+
+  size_t get_rank() const;
+  const std::vector<Boid>& get_owned() const;
+
+  // boids entro d dai bordi interni, da inviare ai vicini come alone; tra la
+  // prima e l'ultima striscia non c'è alone, come nella simulazione seriale
+  void collect_halo(std::vector<Boid>& to_left,
+                    std::vector<Boid>& to_right) const;
+  bool needs_halo(const Boid& bo) const;
+  // regole del moto sui boids propri, con halo come vicini in sola lettura
+  void step(const std::vector<Boid>& halo, double dt);
+  // step in due metà: begin_step calcola i boids lontani dai bordi, che non
+  // dipendono dall'alone, mentre questo è ancora in arrivo; finish_step
+  // calcola gli altri e sposta tutti i boids
+  void begin_step();
+  void finish_step(const std::vector<Boid>& halo, double dt);
+  // toglie i boids usciti dalla striscia, effetto pacman compreso
+  void collect_migrants(std::vector<Boid>& to_left,
+                        std::vector<Boid>& to_right);
+  void receive(const std::vector<Boid>& migrants);
+};
+
+// simulazione su n_workers processi figli che avanzano in passo tra loro,
+// scambiando aloni e boids migranti tramite code in memoria condivisa;
+// restituisce i boids finali ordinati per striscia. Considera le sole regole
+// del moto, con una sola specie; le strisce dividono la larghezza di world
+std::vector<Boid> run_shared_memory(const std::vector<Boid>& b,
+                                    size_t n_workers, int frames, double dt,
+                                    double d, double d_s, double s, double a,
+                                    double c, const Position& world);
+
+} // namespace bd
+#endif
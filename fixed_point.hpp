@@ -0,0 +1,124 @@
+#ifndef FIXED_POINT_HPP
+#define FIXED_POINT_HPP
+
+#include <cmath>
+#include <compare>
+#include <cstdint>
+
+namespace bd {
+
+// numero in virgola fissa Q47.16 su int64: somme e prodotti sono operazioni
+// intere, quindi danno lo stesso risultato con ogni compilatore e opzione
+// di ottimizzazione (niente FMA, niente arrotondamenti dipendenti
+// dall'hardware) e si vettorizzano come normali cicli su interi
+class Fixed
+{
+  std::int64_t raw = 0;
+
+ public:
+  static constexpr int frac_bits    = 16;
+  static constexpr std::int64_t one = std::int64_t{1} << frac_bits;
+
+  constexpr Fixed() = default;
+  constexpr explicit Fixed(int v)
+      : raw{std::int64_t{v} * one}
+  {}
+  // la conversione da double arrotonda al valore rappresentabile più vicino
+  explicit Fixed(double v)
+      : raw{std::llround(v * static_cast<double>(one))}
+  {}
+
+  static constexpr Fixed from_raw(std::int64_t r)
+  {
+    Fixed f;
+    f.raw = r;
+    return f;
+  }
+  constexpr std::int64_t get_raw() const
+  {
+    return raw;
+  }
+  constexpr explicit operator double() const
+  {
+    return static_cast<double>(raw) / static_cast<double>(one);
+  }
+
+  friend constexpr Fixed operator+(Fixed l, Fixed r)
+  {
+    return from_raw(l.raw + r.raw);
+  }
+  friend constexpr Fixed operator-(Fixed l, Fixed r)
+  {
+    return from_raw(l.raw - r.raw);
+  }
+  friend constexpr Fixed operator-(Fixed f)
+  {
+    return from_raw(-f.raw);
+  }
+  friend constexpr Fixed operator*(Fixed l, Fixed r)
+  {
+    return from_raw((l.raw * r.raw) >> frac_bits);
+  }
+  friend constexpr Fixed operator/(Fixed l, Fixed r)
+  {
+    return from_raw((l.raw * one) / r.raw);
+  }
+  friend constexpr Fixed operator/(Fixed l, int n)
+  {
+    return from_raw(l.raw / n);
+  }
+
+  constexpr Fixed& operator+=(Fixed r)
+  {
+    raw += r.raw;
+    return *this;
+  }
+  constexpr Fixed& operator-=(Fixed r)
+  {
+    raw -= r.raw;
+    return *this;
+  }
+  constexpr Fixed& operator*=(Fixed r)
+  {
+    return *this = *this * r;
+  }
+  constexpr Fixed& operator/=(int n)
+  {
+    raw /= n;
+    return *this;
+  }
+
+  friend constexpr auto operator<=>(Fixed, Fixed) = default;
+};
+
+// radice quadrata intera (parte intera di sqrt(n)), cifra per cifra in base 4
+constexpr std::uint64_t isqrt(std::uint64_t n)
+{
+  std::uint64_t res = 0;
+  std::uint64_t bit = std::uint64_t{1} << 62;
+  while (bit > n)
+    bit >>= 2;
+  while (bit != 0) {
+    if (n >= res + bit) {
+      n -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+  return res;
+}
+
+// sqrt(x) = sqrt(raw / one) = isqrt(raw * one) / one
+constexpr Fixed sqrt(Fixed x)
+{
+  if (x.get_raw() <= 0)
+    return Fixed{};
+  const auto r = static_cast<std::uint64_t>(x.get_raw());
+  return Fixed::from_raw(
+      static_cast<std::int64_t>(isqrt(r << Fixed::frac_bits)));
+}
+
+} // namespace bd
+#endif
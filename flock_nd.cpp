@@ -0,0 +1,227 @@
+#include "flock_nd.hpp"
+#include "rules.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace bd {
+
+template <size_t N, class T>
+size_t BasicCellGrid<N, T>::axis_cell(double x, size_t k) const
+{
+  if (!(x > 0.))
+    return 0;
+  return std::min(static_cast<size_t>(x / cell), dims[k] - 1);
+}
+
+template <size_t N, class T>
+void BasicCellGrid<N, T>::build(const std::vector<BasicBoid<N, T>>& b,
+                                const VecN<N, T>& world, T cell_size)
+{
+  boids = &b;
+  cell_start.clear();
+  index.resize(b.size());
+  if (b.empty())
+    return;
+
+  // limite sul numero di celle, oltre il quale il lato viene aumentato
+  constexpr double max_cells = static_cast<double>(size_t{1} << 21);
+  cell = static_cast<double>(cell_size);
+  if (!(cell > 0.))
+    cell = 1.;
+  auto cells_along = [&](size_t k) {
+    return std::max(std::ceil(static_cast<double>(world[k]) / cell), 1.);
+  };
+  auto total = [&]() {
+    double n = 1.;
+    for (size_t k = 0; k < N; ++k)
+      n *= cells_along(k);
+    return n;
+  };
+  while (total() > max_cells)
+    cell *= 2.;
+  size_t n_cells = 1;
+  for (size_t k = 0; k < N; ++k) {
+    dims[k] = static_cast<size_t>(cells_along(k));
+    n_cells *= dims[k];
+  }
+
+  // counting sort degli indici per cella
+  std::vector<size_t> cell_of(b.size());
+  cell_start.assign(n_cells + 1, 0);
+  for (size_t i = 0; i < b.size(); ++i) {
+    size_t cell_id = 0;
+    for (size_t k = N; k-- > 0;)
+      cell_id =
+          cell_id * dims[k] + axis_cell(static_cast<double>(b[i].pos[k]), k);
+    cell_of[i] = cell_id;
+    ++cell_start[cell_id + 1];
+  }
+  for (size_t id = 0; id < n_cells; ++id)
+    cell_start[id + 1] += cell_start[id];
+  std::vector<size_t> fill(cell_start.begin(), cell_start.end() - 1);
+  for (size_t i = 0; i < b.size(); ++i)
+    index[fill[cell_of[i]]++] = i;
+}
+
+template <size_t N, class T>
+BasicMovement<N, T>::BasicMovement(const std::vector<BasicBoid<N, T>>& b_,
+                                   const VecN<N, T>& world_, T d_, T d_s_,
+                                   T s_, T a_, T c_)
+    : boids{b_}
+    , world{world_}
+    , d{d_}
+    , d_s{d_s_}
+    , s{s_}
+    , a{a_}
+    , c{c_}
+{}
+
+template <size_t N, class T>
+const std::vector<BasicBoid<N, T>>& BasicMovement<N, T>::get_boids() const
+{
+  return boids;
+}
+
+template <size_t N, class T>
+T BasicMovement<N, T>::norm2(const VecN<N, T>& v)
+{
+  return bd::norm2(v);
+}
+
+// le regole sono quelle di rules.hpp, comuni al modello 2D
+template <size_t N, class T>
+VecN<N, T> BasicMovement<N, T>::rule1(const VecN<N, T>& pos_i,
+                                      const VecN<N, T>& pos_j) const
+{
+  return separation(pos_i, pos_j, d_s, s);
+}
+
+template <size_t N, class T>
+VecN<N, T> BasicMovement<N, T>::rule2(const VecN<N, T>& vel_i,
+                                      const VecN<N, T>& mean_vel) const
+{
+  return alignment(vel_i, mean_vel, a);
+}
+
+template <size_t N, class T>
+VecN<N, T> BasicMovement<N, T>::rule3(const VecN<N, T>& pos_i,
+                                      const VecN<N, T>& center_mass) const
+{
+  return cohesion(pos_i, center_mass, c);
+}
+
+template <size_t N, class T>
+void BasicMovement<N, T>::check_sides(VecN<N, T>& p) const
+{
+  wrap(p, world);
+}
+
+template <size_t N, class T>
+void BasicMovement<N, T>::limit_velocity(VecN<N, T>& v) const
+{
+  limit_speed(v, T{max_speed});
+}
+
+template <size_t N, class T>
+void BasicMovement<N, T>::build_index()
+{
+  cells.build(boids, world, d);
+}
+
+// Calcola le regole basate sui vicini: con la griglia di lato d si visitano
+// le 3^N celle attorno al boid
+template <size_t N, class T>
+void BasicMovement<N, T>::apply_neighbor_rules(size_t i, VecN<N, T>& v_i) const
+{
+  const BasicBoid<N, T>& self = boids[i];
+  VecN<N, T> center_mass{};
+  VecN<N, T> mean_vel{};
+  int neighbor_count = 0;
+
+  auto add_neighbor = [&](size_t j) {
+    if (i == j)
+      return;
+    const BasicBoid<N, T>& other = boids[j];
+    const VecN<N, T> sep         = rule1(self.pos, other.pos);
+    for (size_t k = 0; k < N; ++k) {
+      center_mass[k] += other.pos[k];
+      mean_vel[k] += other.vel[k];
+      v_i[k] += sep[k];
+    }
+    ++neighbor_count;
+  };
+
+  if (!cells.empty()) {
+    cells.for_each_within(self.pos, d, add_neighbor);
+  } else {
+    for (size_t j = 0; j < boids.size(); ++j) {
+      VecN<N, T> diff;
+      for (size_t k = 0; k < N; ++k)
+        diff[k] = self.pos[k] - boids[j].pos[k];
+      if (norm2(diff) < d * d)
+        add_neighbor(j);
+    }
+  }
+
+  if (neighbor_count > 0) {
+    for (size_t k = 0; k < N; ++k) {
+      center_mass[k] /= neighbor_count;
+      mean_vel[k] /= neighbor_count;
+    }
+    const VecN<N, T> align = rule2(self.vel, mean_vel);
+    const VecN<N, T> coh   = rule3(self.pos, center_mass);
+    for (size_t k = 0; k < N; ++k)
+      v_i[k] += align[k] + coh[k];
+  }
+}
+
+// Aggiorna la posizione e la velocità dei boid ad ogni frame
+template <size_t N, class T>
+void BasicMovement<N, T>::update(T dt)
+{
+  build_index();
+  std::vector<VecN<N, T>> vel_tot(boids.size());
+  for (size_t i = 0; i < boids.size(); ++i) {
+    vel_tot[i] = boids[i].vel;
+    apply_neighbor_rules(i, vel_tot[i]);
+    limit_velocity(vel_tot[i]);
+  }
+  for (size_t i = 0; i < boids.size(); ++i) {
+    for (size_t k = 0; k < N; ++k)
+      boids[i].pos[k] += vel_tot[i][k] * dt;
+    boids[i].vel = vel_tot[i];
+    check_sides(boids[i].pos);
+  }
+}
+
+std::uint64_t state_hash(const std::vector<FixedBoid>& b)
+{
+  std::uint64_t h = 14695981039346656037ull;
+  auto mix        = [&h](Fixed x) {
+    auto raw = static_cast<std::uint64_t>(x.get_raw());
+    for (int k = 0; k < 8; ++k) {
+      h ^= raw & 0xffu;
+      h *= 1099511628211ull;
+      raw >>= 8;
+    }
+  };
+  for (const FixedBoid& f : b) {
+    for (size_t k = 0; k < 2; ++k) {
+      mix(f.pos[k]);
+      mix(f.vel[k]);
+    }
+  }
+  return h;
+}
+
+template class BasicCellGrid<2>;
+template class BasicCellGrid<3>;
+template class BasicCellGrid<2, Fixed>;
+template class BasicCellGrid<3, Fixed>;
+template class BasicMovement<2>;
+template class BasicMovement<3>;
+template class BasicMovement<2, Fixed>;
+template class BasicMovement<3, Fixed>;
+
+} // namespace bd
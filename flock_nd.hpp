@@ -0,0 +1,158 @@
+#ifndef FLOCK_ND_HPP
+#define FLOCK_ND_HPP
+
+#include "fixed_point.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bd {
+
+// versione del modello templata sulla dimensione N (2 o 3) e sul tipo
+// scalare T (double oppure Fixed): posizioni e velocità hanno N componenti,
+// la griglia usa stencil di 3^N celle.
+// Limite noto: Movement resta un modello 2D in double separato da questo,
+// quindi la virgola fissa vale solo per il modello di base.
+// Le regole, i bordi periodici e il limite di velocità sono quelli comuni di
+// rules.hpp, ma la griglia è una seconda copia e specie, campo visivo,
+// ostacoli, forze, bordi, integratori e celle dormienti esistono solo in
+// Movement; validate() rifiuta quei parametri insieme a --3d
+template <size_t N, class T = double>
+using VecN = std::array<T, N>;
+
+template <size_t N, class T = double>
+struct BasicBoid
+{
+  VecN<N, T> pos{};
+  VecN<N, T> vel{};
+};
+
+// griglia uniforme N-dimensionale sul mondo [0, world), indici dei boids
+// ordinati per cella; la cella si calcola in double, il test sulla distanza
+// resta nel tipo T
+template <size_t N, class T = double>
+class BasicCellGrid
+{
+  double cell = 1.;
+  std::array<size_t, N> dims{};
+  std::vector<size_t> cell_start;
+  std::vector<size_t> index;
+  const std::vector<BasicBoid<N, T>>* boids = nullptr;
+
+  size_t axis_cell(double x, size_t k) const;
+
+ public:
+  void build(const std::vector<BasicBoid<N, T>>& b, const VecN<N, T>& world,
+             T cell_size);
+  bool empty() const
+  {
+    return cell_start.empty();
+  }
+  // visita i boids entro r da p, f riceve l'indice del boid
+  template <class F>
+  void for_each_within(const VecN<N, T>& p, T r, F&& f) const;
+};
+
+template <size_t N, class T = double>
+class BasicMovement
+{
+  std::vector<BasicBoid<N, T>> boids;
+  VecN<N, T> world;
+  T d;
+  T d_s;
+  T s;
+  T a;
+  T c;
+  BasicCellGrid<N, T> cells;
+
+ public:
+  static constexpr int max_speed = 700;
+
+  explicit BasicMovement(const std::vector<BasicBoid<N, T>>& b_,
+                         const VecN<N, T>& world_, T d_ = T{}, T d_s_ = T{},
+                         T s_ = T{}, T a_ = T{}, T c_ = T{});
+
+  const std::vector<BasicBoid<N, T>>& get_boids() const;
+  static T norm2(const VecN<N, T>& v);
+
+  // regole del moto
+  VecN<N, T> rule1(const VecN<N, T>& pos_i, const VecN<N, T>& pos_j) const;
+  VecN<N, T> rule2(const VecN<N, T>& vel_i, const VecN<N, T>& mean_vel) const;
+  VecN<N, T> rule3(const VecN<N, T>& pos_i,
+                   const VecN<N, T>& center_mass) const;
+
+  void check_sides(VecN<N, T>& p) const;
+  void limit_velocity(VecN<N, T>& v) const;
+
+  void build_index();
+  void apply_neighbor_rules(size_t i, VecN<N, T>& v_i) const;
+  void update(T dt);
+};
+
+template <size_t N, class T>
+template <class F>
+void BasicCellGrid<N, T>::for_each_within(const VecN<N, T>& p, T r,
+                                          F&& f) const
+{
+  if (cell_start.empty() || !(r > T{}))
+    return;
+  std::array<size_t, N> lo;
+  std::array<size_t, N> hi;
+  for (size_t k = 0; k < N; ++k) {
+    lo[k] = axis_cell(static_cast<double>(p[k] - r), k);
+    hi[k] = axis_cell(static_cast<double>(p[k] + r), k);
+  }
+  // contatore su N cifre che scorre tutte le celle del blocco [lo, hi]
+  std::array<size_t, N> idx = lo;
+  while (true) {
+    size_t cell_id = 0;
+    for (size_t k = N; k-- > 0;)
+      cell_id = cell_id * dims[k] + idx[k];
+    for (size_t j = cell_start[cell_id]; j < cell_start[cell_id + 1]; ++j) {
+      const BasicBoid<N, T>& other = (*boids)[index[j]];
+      T dist2{};
+      for (size_t k = 0; k < N; ++k)
+        dist2 += (other.pos[k] - p[k]) * (other.pos[k] - p[k]);
+      if (dist2 < r * r)
+        f(index[j]);
+    }
+    size_t k = 0;
+    while (k < N && idx[k] == hi[k]) {
+      idx[k] = lo[k];
+      ++k;
+    }
+    if (k == N)
+      break;
+    ++idx[k];
+  }
+}
+
+extern template class BasicCellGrid<2>;
+extern template class BasicCellGrid<3>;
+extern template class BasicCellGrid<2, Fixed>;
+extern template class BasicCellGrid<3, Fixed>;
+extern template class BasicMovement<2>;
+extern template class BasicMovement<3>;
+extern template class BasicMovement<2, Fixed>;
+extern template class BasicMovement<3, Fixed>;
+
+using Boid3     = BasicBoid<3>;
+using Movement3 = BasicMovement<3>;
+
+// simulazione in virgola fissa: a parità di input dà gli stessi bit su ogni
+// piattaforma
+using FixedBoid     = BasicBoid<2, Fixed>;
+using FixedMovement = BasicMovement<2, Fixed>;
+
+// impronta (FNV-1a) dei bit dello stato, da confrontare tra macchine diverse
+std::uint64_t state_hash(const std::vector<FixedBoid>& b);
+
+// proiezione sul piano x-y, usata per disegnare la simulazione 3D
+inline std::array<double, 2> project_xy(const VecN<3>& v)
+{
+  return {v[0], v[1]};
+}
+
+} // namespace bd
+#endif
@@ -0,0 +1,199 @@
+#include "force_field.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace bd {
+
+namespace {
+// punto della forma dell'emettitore più vicino a p
+Position closest_point(const Emitter& e, const Position& p)
+{
+  switch (e.shape) {
+  case Emitter::Shape::line: {
+    const double ex  = e.b[0] - e.a[0];
+    const double ey  = e.b[1] - e.a[1];
+    const double len = ex * ex + ey * ey;
+    double t         = 0.;
+    if (len > 0.)
+      t = std::clamp(((p[0] - e.a[0]) * ex + (p[1] - e.a[1]) * ey) / len, 0.,
+                     1.);
+    return {e.a[0] + t * ex, e.a[1] + t * ey};
+  }
+  case Emitter::Shape::region: {
+    const Position q{std::clamp(p[0], e.a[0], e.b[0]),
+                     std::clamp(p[1], e.a[1], e.b[1])};
+    // dentro la regione si punta al suo centro
+    if (q == p)
+      return {0.5 * (e.a[0] + e.b[0]), 0.5 * (e.a[1] + e.b[1])};
+    return q;
+  }
+  case Emitter::Shape::point:
+    break;
+  }
+  return e.a;
+}
+
+// rettangolo di ingombro dell'emettitore, allargato del suo raggio
+std::array<double, 4> bounds(const Emitter& e)
+{
+  Position lo = e.a;
+  Position hi = e.a;
+  if (e.shape != Emitter::Shape::point) {
+    lo = {std::min(e.a[0], e.b[0]), std::min(e.a[1], e.b[1])};
+    hi = {std::max(e.a[0], e.b[0]), std::max(e.a[1], e.b[1])};
+  }
+  return {lo[0] - e.radius, lo[1] - e.radius, hi[0] + e.radius,
+          hi[1] + e.radius};
+}
+
+// controlla il raggio e porta gli angoli della regione nell'ordine
+// minimo/massimo atteso da closest_point
+Emitter checked(Emitter e)
+{
+  if (e.radius <= 0.)
+    throw std::invalid_argument("Il raggio dell'emettitore deve essere "
+                                "positivo");
+  if (e.shape == Emitter::Shape::region) {
+    for (size_t k = 0; k < 2; ++k) {
+      if (e.a[k] > e.b[k])
+        std::swap(e.a[k], e.b[k]);
+    }
+  }
+  return e;
+}
+} // namespace
+
+Velocity emitter_force(const Emitter& e, const Position& p)
+{
+  const Position q     = closest_point(e, p);
+  const double dx      = q[0] - p[0];
+  const double dy      = q[1] - p[1];
+  const double dist_sq = dx * dx + dy * dy;
+  if (dist_sq >= e.radius * e.radius)
+    return {0., 0.};
+
+  const double dist = std::sqrt(dist_sq + 1e-6);
+  double scale      = 1.;
+  switch (e.falloff) {
+  case Emitter::Falloff::linear:
+    scale = 1. - dist / e.radius;
+    break;
+  case Emitter::Falloff::quadratic:
+    scale = (1. - dist / e.radius) * (1. - dist / e.radius);
+    break;
+  case Emitter::Falloff::constant:
+    break;
+  }
+  const double force = e.strength * std::max(scale, 0.);
+  return {force * dx / dist, force * dy / dist};
+}
+
+size_t ForceField::add(const Emitter& e)
+{
+  emitters.push_back(checked(e));
+  bin_start.clear();
+  return emitters.size() - 1;
+}
+
+void ForceField::set(size_t i, const Emitter& e)
+{
+  assert(i < emitters.size());
+  emitters[i] = checked(e);
+  bin_start.clear();
+}
+
+void ForceField::clear()
+{
+  emitters.clear();
+  bin_start.clear();
+  bin_items.clear();
+}
+
+const std::vector<Emitter>& ForceField::get_emitters() const
+{
+  return emitters;
+}
+
+bool ForceField::empty() const
+{
+  return emitters.empty();
+}
+
+void ForceField::bin(double width, double height, double cell_size)
+{
+  if (width <= 0. || height <= 0. || cell_size <= 0.)
+    throw std::invalid_argument("Parametri della griglia degli emettitori non "
+                                "validi");
+  cell = cell_size;
+  nx   = static_cast<size_t>(std::ceil(width / cell));
+  ny   = static_cast<size_t>(std::ceil(height / cell));
+
+  auto cell_range = [this](double lo, double hi, size_t n) {
+    const double last = static_cast<double>(n - 1);
+    return std::array<size_t, 2>{
+        static_cast<size_t>(std::clamp(std::floor(lo / cell), 0., last)),
+        static_cast<size_t>(std::clamp(std::floor(hi / cell), 0., last))};
+  };
+
+  // due passate: conteggio per cella e poi riempimento (come un CSR)
+  bin_start.assign(nx * ny + 1, 0);
+  for (int pass = 0; pass < 2; ++pass) {
+    std::vector<size_t> fill(bin_start.begin(), bin_start.end() - 1);
+    for (size_t k = 0; k < emitters.size(); ++k) {
+      const std::array<double, 4> box = bounds(emitters[k]);
+      const auto xr                   = cell_range(box[0], box[2], nx);
+      const auto yr                   = cell_range(box[1], box[3], ny);
+      for (size_t cy = yr[0]; cy <= yr[1]; ++cy) {
+        for (size_t cx = xr[0]; cx <= xr[1]; ++cx) {
+          if (pass == 0)
+            ++bin_start[cy * nx + cx + 1];
+          else
+            bin_items[fill[cy * nx + cx]++] = k;
+        }
+      }
+    }
+    if (pass == 0) {
+      for (size_t c = 0; c < nx * ny; ++c)
+        bin_start[c + 1] += bin_start[c];
+      bin_items.resize(bin_start.back());
+    }
+  }
+}
+
+bool ForceField::binned() const
+{
+  return !bin_start.empty();
+}
+
+size_t ForceField::cell_of(const Position& p) const
+{
+  const size_t cx =
+      std::min(static_cast<size_t>(std::max(p[0] / cell, 0.)), nx - 1);
+  const size_t cy =
+      std::min(static_cast<size_t>(std::max(p[1] / cell, 0.)), ny - 1);
+  return cy * nx + cx;
+}
+
+size_t ForceField::candidates(const Position& p) const
+{
+  if (bin_start.empty())
+    return 0;
+  const size_t c = cell_of(p);
+  return bin_start[c + 1] - bin_start[c];
+}
+
+Velocity ForceField::force(const Position& p) const
+{
+  Velocity res{0., 0.};
+  if (bin_start.empty())
+    return res;
+  const size_t c = cell_of(p);
+  for (size_t k = bin_start[c]; k < bin_start[c + 1]; ++k)
+    add_inplace(res, emitter_force(emitters[bin_items[k]], p));
+  return res;
+}
+
+} // namespace bd
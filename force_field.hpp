@@ -0,0 +1,72 @@
+#ifndef FORCE_FIELD_HPP
+#define FORCE_FIELD_HPP
+
+#include "boid.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// sorgente di forza: attrae verso la forma con strength > 0, respinge con
+// strength < 0, entro radius dal punto più vicino della forma
+struct Emitter
+{
+  enum class Shape
+  {
+    point,  // punto a
+    line,   // segmento da a a b
+    region  // rettangolo con angoli a (minimo) e b (massimo); add e set
+            // riordinano gli angoli scambiati
+  };
+  enum class Falloff
+  {
+    constant,
+    linear,   // 1 - dist / radius
+    quadratic // (1 - dist / radius)^2
+  };
+
+  Shape shape = Shape::point;
+  Position a{};
+  Position b{};
+  double radius   = 80;
+  double strength = 40;
+  Falloff falloff = Falloff::constant;
+};
+
+// forza di un singolo emettitore sul punto p
+Velocity emitter_force(const Emitter& e, const Position& p);
+
+// insieme di emettitori suddivisi nelle celle di una griglia sul mondo:
+// ogni boid valuta solo quelli che toccano la sua cella
+class ForceField
+{
+  std::vector<Emitter> emitters;
+
+  double cell = 0.;
+  size_t nx   = 0;
+  size_t ny   = 0;
+  std::vector<size_t> bin_start; // nx * ny + 1 elementi
+  std::vector<size_t> bin_items; // indici degli emettitori per cella
+
+  size_t cell_of(const Position& p) const;
+
+ public:
+  // lanciano std::invalid_argument se il raggio non è positivo
+  size_t add(const Emitter& e);
+  void set(size_t i, const Emitter& e);
+  void clear();
+  const std::vector<Emitter>& get_emitters() const;
+  bool empty() const;
+
+  // assegna gli emettitori alle celle di lato cell_size su width x height;
+  // va richiamato dopo ogni modifica
+  void bin(double width, double height, double cell_size);
+  bool binned() const;
+  // numero di emettitori da valutare nella cella di p
+  size_t candidates(const Position& p) const;
+
+  Velocity force(const Position& p) const;
+};
+
+} // namespace bd
+#endif
@@ -0,0 +1,53 @@
+#ifndef INTEGRATOR_HPP
+#define INTEGRATOR_HPP
+
+namespace bd {
+
+enum class Integrator
+{
+  explicit_euler,
+  semi_implicit_euler, // quello storico: prima la velocità, poi la posizione
+  velocity_verlet,
+  rk2, // punto medio
+};
+
+// Politiche di integrazione, parametri di template del passo di Movement.
+// Con dv la variazione di velocità data dalle regole nello stato (x, v):
+//   x' = x + (v + drift * dv) * h
+// e la velocità finale è v + dv, corretta secondo la fase aggiuntiva:
+// corrector rivaluta le regole in x' (Verlet), midpoint le valuta a metà
+// passo e usa quella variazione (RK2). Le fasi aggiuntive costano una
+// seconda ricerca dei vicini per passo.
+enum class IntegratorStage
+{
+  none,
+  corrector,
+  midpoint,
+};
+
+struct ExplicitEuler
+{
+  static constexpr double drift          = 0.;
+  static constexpr IntegratorStage stage = IntegratorStage::none;
+};
+
+struct SemiImplicitEuler
+{
+  static constexpr double drift          = 1.;
+  static constexpr IntegratorStage stage = IntegratorStage::none;
+};
+
+struct VelocityVerlet
+{
+  static constexpr double drift          = 0.5;
+  static constexpr IntegratorStage stage = IntegratorStage::corrector;
+};
+
+struct Rk2
+{
+  static constexpr double drift          = 0.5;
+  static constexpr IntegratorStage stage = IntegratorStage::midpoint;
+};
+
+} // namespace bd
+#endif
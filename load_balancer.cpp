@@ -0,0 +1,202 @@
+#include "load_balancer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
+
+namespace bd {
+
+void OrbPartition::split(size_t node, std::vector<size_t>& items, Position lo,
+                         Position hi, size_t parts, size_t first_part,
+                         const std::vector<Boid>& b,
+                         const std::vector<double>& w)
+{
+  if (parts == 1) {
+    nodes[node].part = first_part;
+    return;
+  }
+  const size_t axis   = hi[0] - lo[0] >= hi[1] - lo[1] ? 0 : 1;
+  const size_t n_left = parts / 2;
+  const double frac =
+      static_cast<double>(n_left) / static_cast<double>(parts);
+
+  std::sort(items.begin(), items.end(), [&](size_t i, size_t j) {
+    return b[i].pos[axis] < b[j].pos[axis];
+  });
+  auto weight = [&w](size_t i) { return w.empty() ? 1. : w[i]; };
+  double total = 0.;
+  for (const size_t i : items)
+    total += weight(i);
+
+  // il taglio cade a metà tra l'ultimo boid a sinistra e il primo a destra
+  double cut  = lo[axis] + frac * (hi[axis] - lo[axis]);
+  size_t k    = 0;
+  double left = 0.;
+  while (k < items.size() && left + weight(items[k]) <= frac * total) {
+    left += weight(items[k]);
+    ++k;
+  }
+  if (k > 0 && k < items.size())
+    cut = 0.5 * (b[items[k - 1]].pos[axis] + b[items[k]].pos[axis]);
+  else if (k == items.size() && k > 0)
+    cut = 0.5 * (b[items[k - 1]].pos[axis] + hi[axis]);
+  else if (k == 0 && !items.empty())
+    cut = 0.5 * (lo[axis] + b[items[0]].pos[axis]);
+
+  const size_t child = nodes.size();
+  nodes[node].axis   = axis;
+  nodes[node].cut    = cut;
+  nodes[node].child  = child;
+  nodes.resize(nodes.size() + 2);
+
+  std::vector<size_t> right(items.begin() + static_cast<std::ptrdiff_t>(k),
+                            items.end());
+  items.resize(k);
+  Position mid_hi = hi;
+  Position mid_lo = lo;
+  mid_hi[axis]    = cut;
+  mid_lo[axis]    = cut;
+  split(child, items, lo, mid_hi, n_left, first_part, b, w);
+  split(child + 1, right, mid_lo, hi, parts - n_left, first_part + n_left, b,
+        w);
+}
+
+void OrbPartition::build(const std::vector<Boid>& b,
+                         const std::vector<double>& weights, size_t parts,
+                         const Position& lo, const Position& hi)
+{
+  if (parts == 0)
+    throw std::invalid_argument("Il numero di parti deve essere positivo");
+  assert(weights.empty() || weights.size() == b.size());
+  n_parts = parts;
+  nodes.assign(1, Node{});
+  std::vector<size_t> items(b.size());
+  std::iota(items.begin(), items.end(), size_t{0});
+  split(0, items, lo, hi, parts, 0, b, weights);
+}
+
+bool OrbPartition::empty() const
+{
+  return nodes.empty();
+}
+
+size_t OrbPartition::size() const
+{
+  return n_parts;
+}
+
+size_t OrbPartition::owner(const Position& p) const
+{
+  assert(!nodes.empty());
+  size_t node = 0;
+  while (nodes[node].child != 0)
+    node = nodes[node].child
+         + (p[nodes[node].axis] < nodes[node].cut ? 0 : 1);
+  return nodes[node].part;
+}
+
+LoadBalancer::LoadBalancer(const Position& world_, size_t n_parts_,
+                           int every_, double migration_cost_)
+    : world{world_}
+    , n_parts{n_parts_}
+    , every{every_}
+    , migration_cost{migration_cost_}
+    , cost(n_parts_, 0.)
+    , work(n_parts_, 0)
+{
+  if (n_parts == 0 || every < 1 || migration_cost < 0.)
+    throw std::invalid_argument("Parametri del bilanciamento non validi");
+}
+
+void LoadBalancer::reset(const std::vector<Boid>& b)
+{
+  part.build(b, {}, n_parts, {0., 0.}, world);
+  frames = 0;
+  std::fill(cost.begin(), cost.end(), 0.);
+  std::fill(work.begin(), work.end(), 0);
+}
+
+const OrbPartition& LoadBalancer::partition() const
+{
+  return part;
+}
+
+size_t LoadBalancer::size() const
+{
+  return n_parts;
+}
+
+void LoadBalancer::record(size_t p, size_t n_boids, double seconds)
+{
+  assert(p < n_parts);
+  cost[p] += seconds;
+  work[p] += n_boids;
+}
+
+bool LoadBalancer::end_frame(const std::vector<Boid>& b)
+{
+  if (part.empty())
+    reset(b);
+  if (++frames < every)
+    return false;
+
+  const double total_cost = std::accumulate(cost.begin(), cost.end(), 0.);
+  const size_t total_work = std::accumulate(work.begin(), work.end(),
+                                            size_t{0});
+  const double max_cost   = *std::max_element(cost.begin(), cost.end());
+  last_imbalance          = total_cost > 0.
+                              ? max_cost * static_cast<double>(n_parts)
+                                    / total_cost
+                              : 1.;
+  if (total_work == 0 || total_cost <= 0. || b.empty()) {
+    reset(b);
+    return false;
+  }
+
+  // costo per boid e per frame di ogni parte, misurato
+  const double mean = total_cost / static_cast<double>(total_work);
+  std::vector<double> per_boid(n_parts, mean);
+  for (size_t p = 0; p < n_parts; ++p) {
+    if (work[p] > 0)
+      per_boid[p] = cost[p] / static_cast<double>(work[p]);
+  }
+  std::vector<double> weights(b.size());
+  std::vector<size_t> old_owner(b.size());
+  std::vector<double> old_load(n_parts, 0.);
+  for (size_t i = 0; i < b.size(); ++i) {
+    old_owner[i] = part.owner(b[i].pos);
+    weights[i]   = per_boid[old_owner[i]];
+    old_load[old_owner[i]] += weights[i];
+  }
+
+  OrbPartition candidate;
+  candidate.build(b, weights, n_parts, {0., 0.}, world);
+  std::vector<double> new_load(n_parts, 0.);
+  size_t moved = 0;
+  for (size_t i = 0; i < b.size(); ++i) {
+    const size_t o = candidate.owner(b[i].pos);
+    new_load[o] += weights[i];
+    moved += o != old_owner[i] ? 1u : 0u;
+  }
+
+  // un frame dura quanto la parte più lenta
+  const double gain =
+      (*std::max_element(old_load.begin(), old_load.end())
+       - *std::max_element(new_load.begin(), new_load.end()))
+      * every;
+  const bool adopt =
+      gain > static_cast<double>(moved) * mean * migration_cost;
+  if (adopt)
+    part = candidate;
+  frames = 0;
+  std::fill(cost.begin(), cost.end(), 0.);
+  std::fill(work.begin(), work.end(), 0);
+  return adopt;
+}
+
+double LoadBalancer::imbalance() const
+{
+  return last_imbalance;
+}
+
+} // namespace bd
@@ -0,0 +1,73 @@
+#ifndef LOAD_BALANCER_HPP
+#define LOAD_BALANCER_HPP
+
+#include "boid.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// bisezione ortogonale ricorsiva (ORB): ogni taglio divide il lato più
+// lungo del riquadro in modo che le due metà abbiano un peso proporzionale
+// al numero di parti che ricevono
+class OrbPartition
+{
+  struct Node
+  {
+    size_t axis  = 0;
+    double cut   = 0.;
+    size_t child = 0; // primo dei due figli, 0 per le foglie
+    size_t part  = 0; // parte della foglia
+  };
+  std::vector<Node> nodes;
+  size_t n_parts = 0;
+
+  void split(size_t node, std::vector<size_t>& items, Position lo,
+             Position hi, size_t parts, size_t first_part,
+             const std::vector<Boid>& b, const std::vector<double>& w);
+
+ public:
+  // weights ha un peso per boid (vuoto = tutti uguali)
+  void build(const std::vector<Boid>& b, const std::vector<double>& weights,
+             size_t parts, const Position& lo, const Position& hi);
+  bool empty() const;
+  size_t size() const;
+  size_t owner(const Position& p) const;
+};
+
+// misura il costo di ogni parte e ogni every frame ricalcola l'ORB pesando
+// ogni boid con il costo medio per boid della sua parte; la nuova partizione
+// è adottata solo se il guadagno previsto sui prossimi every frame supera
+// il costo di spostare i boids che cambiano parte
+class LoadBalancer
+{
+  OrbPartition part;
+  Position world;
+  size_t n_parts;
+  int every;
+  double migration_cost; // in unità del costo medio di un boid in un frame
+  int frames = 0;
+  std::vector<double> cost; // secondi per parte dall'ultimo bilanciamento
+  std::vector<size_t> work; // boids elaborati per parte nello stesso tempo
+  double last_imbalance = 1.;
+
+ public:
+  // world: dimensioni del mondo [0, world[0]) x [0, world[1])
+  LoadBalancer(const Position& world_, size_t n_parts_, int every_ = 30,
+               double migration_cost_ = 1.);
+
+  // partizione iniziale con tutti i boids di peso uguale
+  void reset(const std::vector<Boid>& b);
+  const OrbPartition& partition() const;
+  size_t size() const;
+
+  void record(size_t p, size_t n_boids, double seconds);
+  // da chiamare a fine frame; vero se la partizione è cambiata
+  bool end_frame(const std::vector<Boid>& b);
+  // rapporto tra il costo massimo e quello medio delle parti, misurato
+  // nell'ultimo intervallo
+  double imbalance() const;
+};
+
+} // namespace bd
+#endif
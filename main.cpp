@@ -1,81 +1,238 @@
 #include "boids_logic.hpp"
+#include "camera.hpp"
+#include "config.hpp"
+#include "domain.hpp"
+#include "flock_nd.hpp"
+#include "recorder.hpp"
+#include "renderer.hpp"
+#include "socket_transport.hpp"
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <random>
+#include <string_view>
 
-int main()
+// simulazione 3D, disegnata come proiezione sul piano x-y
+static void run_3d(const bd::SimConfig& cfg,
+                   const std::vector<bd::Boid3>& initials)
 {
-  try {
-    std::random_device r;
-    std::default_random_engine eng{r()};
-    std::uniform_real_distribution<double> dist(-1, 1);
-    // Input parametri boids
-    size_t n_b;
-    double d, d_s, s, a, c;
-    std::cout << "Inserisci il numero di boids: ";
-    std::cin >> n_b;
-    if (std::cin.fail()) {
-      throw std::invalid_argument("numero di boids non valido");
-    }
+  bd::Movement3 mov3(initials,
+                     {cfg.world_width, cfg.world_height, cfg.world_depth},
+                     cfg.d, cfg.d_s, cfg.s, cfg.a, cfg.c);
+  const bd::Movement painter{};
+  sf::RenderWindow window(sf::VideoMode(cfg.window_width, cfg.window_height),
+                          "Boids Simulation 3D");
+  const int FPS = cfg.fps;
+  window.setFramerateLimit(static_cast<unsigned>(FPS));
+  window.setView(sf::View(sf::FloatRect(0.f, 0.f,
+                                        static_cast<float>(cfg.world_width),
+                                        static_cast<float>(cfg.world_height))));
 
-    std::cout << "Inserisci la distanza di interazione (d): ";
-    std::cin >> d;
-    if (std::cin.fail() || d <= 0) {
-      throw std::invalid_argument(
-          "La distanza di interazione deve essere positiva");
+  while (window.isOpen()) {
+    sf::Event event;
+    while (window.pollEvent(event)) {
+      if (event.type == sf::Event::Closed)
+        window.close();
     }
+    mov3.update(1. / FPS);
 
-    std::cout << "Inserisci la distanza di separazione (d_s): ";
-    std::cin >> d_s;
-    if (std::cin.fail() || d_s <= 0) {
-      throw std::invalid_argument(
-          "La distanza di separazione deve essere positiva");
-    }
-    if (d_s > d) {
-      throw std::invalid_argument("La distanza di separazione non può essere "
-                                  "maggiore della distanza di interazione");
-    }
+    window.clear(sf::Color::Black);
+    for (const bd::Boid3& b : mov3.get_boids())
+      painter.draw_boids(bd::project_xy(b.pos), bd::project_xy(b.vel), window);
+    window.display();
+  }
+}
 
-    std::cout << "Inserisci il coefficiente di separazione (s): ";
-    std::cin >> s;
-    if (std::cin.fail() || s < 0) {
-      throw std::invalid_argument(
-          "Il coefficiente di separazione deve essere positivo");
-    }
+// applica al modello i parametri della configurazione
+static void configure(bd::Movement& mov, const bd::SimConfig& cfg)
+{
+  mov.set_neighbor_search(cfg.search, cfg.theta);
+  mov.set_field_of_view(cfg.fov);
+  if (cfg.threading != bd::ThreadingMode::serial) {
+    mov.set_threads(cfg.n_threads, cfg.rebalance_every, cfg.migration_cost);
+    mov.set_work_stealing(cfg.threading == bd::ThreadingMode::work_stealing);
+  }
+  if (cfg.n_species > 1) {
+    // s, a, c sulla diagonale, i coefficienti cross altrove
+    std::vector<bd::Interaction> matrix(cfg.n_species * cfg.n_species,
+                                        {cfg.cross_s, cfg.cross_a,
+                                         cfg.cross_c});
+    for (size_t t = 0; t < cfg.n_species; ++t)
+      matrix[t * cfg.n_species + t] = {cfg.s, cfg.a, cfg.c};
+    mov.set_species(cfg.n_species, matrix);
+  }
+  if (!cfg.obstacles.empty())
+    mov.set_obstacles(cfg.obstacles, cfg.obstacle_resolution);
+  if (!cfg.forces.empty())
+    mov.set_force_field(cfg.forces);
+  mov.set_boundary(cfg.boundary, cfg.margin, cfg.turn);
+  mov.set_integrator(cfg.integrator);
+  mov.set_substepping(cfg.substepping, cfg.substep_fraction,
+                      cfg.max_substeps);
+  if (cfg.sleeping)
+    mov.set_sleeping(true, cfg.sleep_threshold, cfg.sleep_frames);
+  mov.set_stats_interval(cfg.stats_interval);
+  mov.set_stats_error(cfg.stats_error);
+  mov.set_flock_metrics(cfg.metrics);
+}
 
-    std::cout << "Inserisci il coefficiente di allineamento (a): ";
-    std::cin >> a;
-    if (std::cin.fail() || a < 0 || a > 1) {
-      throw std::invalid_argument("Il coefficiente di allineamento deve essere "
-                                  "un numero compreso tra 0 e 1");
-    }
+// simulazione senza finestra di cfg.frames frame: con il registratore ogni
+// stride frame l'immagine viene disegnata su CPU e salvata in background
+static void run_headless(bd::Movement& mov, const bd::SimConfig& cfg,
+                         bd::FlockRenderer& renderer,
+                         bd::FrameRecorder* recorder)
+{
+  const sf::View view(sf::FloatRect(0.f, 0.f,
+                                    static_cast<float>(cfg.world_width),
+                                    static_cast<float>(cfg.world_height)));
+  const double dt = 1. / cfg.fps;
+  for (int frame = 0; frame < cfg.frames; ++frame) {
+    mov.update(frame, dt);
+    if (recorder != nullptr && recorder->wants(frame))
+      recorder->submit(frame, renderer.render(mov.get_boids(),
+                                              mov.get_predators(), view,
+                                              mov.get_scheduler(),
+                                              &mov.get_speeds()));
+  }
+  if (recorder == nullptr)
+    return;
+  recorder->flush();
+  std::cout << "Frame salvati: " << recorder->written()
+            << ", scartati: " << recorder->dropped() << '\n';
+}
+
+// cfg.frames frame con il mondo diviso in strisce tra cfg.n_threads processi
+static void run_distributed(const std::vector<bd::Boid>& initials,
+                            const bd::SimConfig& cfg)
+{
+  const bd::Position world{cfg.world_width, cfg.world_height};
+  const double dt = 1. / cfg.fps;
+  const std::vector<bd::Boid> result =
+      cfg.threading == bd::ThreadingMode::shared_memory
+          ? bd::run_shared_memory(initials, cfg.n_threads, cfg.frames, dt,
+                                  cfg.d, cfg.d_s, cfg.s, cfg.a, cfg.c, world)
+          : bd::run_sockets(initials, cfg.n_threads, cfg.transport,
+                            cfg.frames, dt, cfg.d, cfg.d_s, cfg.s, cfg.a,
+                            cfg.c, world);
+  std::cout << "Frame simulati: " << cfg.frames
+            << ", boids: " << result.size() << '\n';
+}
 
-    std::cout << "Inserisci il coefficiente di coesione (c): ";
-    std::cin >> c;
-    if (std::cin.fail() || c < 0 || c > 1) {
-      throw std::invalid_argument(
-          "Il coefficiente di coesione deve essere compreso tra 0 e 1");
+// cfg.frames frame del modello di base in virgola fissa: l'impronta finale
+// è la stessa su ogni macchina a parità di seme e parametri
+static void run_fixed(const std::vector<bd::Boid>& initials,
+                      const bd::SimConfig& cfg)
+{
+  std::vector<bd::FixedBoid> boids;
+  boids.reserve(initials.size());
+  for (const bd::Boid& b : initials)
+    boids.push_back({{bd::Fixed(b.pos[0]), bd::Fixed(b.pos[1])},
+                     {bd::Fixed(b.vel[0]), bd::Fixed(b.vel[1])}});
+  bd::FixedMovement mov(boids,
+                        {bd::Fixed(cfg.world_width),
+                         bd::Fixed(cfg.world_height)},
+                        bd::Fixed(cfg.d), bd::Fixed(cfg.d_s), bd::Fixed(cfg.s),
+                        bd::Fixed(cfg.a), bd::Fixed(cfg.c));
+  const bd::Fixed dt(1. / cfg.fps);
+  for (int frame = 0; frame < cfg.frames; ++frame)
+    mov.update(dt);
+  std::cout << "Frame simulati: " << cfg.frames << ", impronta: " << std::hex
+            << bd::state_hash(mov.get_boids()) << std::dec << '\n';
+}
+
+int main(int argc, char* argv[])
+{
+  try {
+    // parametri da file (--config) e da riga di comando, controllati
+    // tutti prima di allocare qualsiasi cosa
+    for (int k = 1; k < argc; ++k) {
+      const std::string_view arg(argv[k]);
+      if (arg == "--help" || arg == "-h") {
+        std::cout << bd::config_usage();
+        return 0;
+      }
     }
+    const bd::SimConfig cfg = bd::parse_command_line(argc, argv);
+    bd::validate(cfg);
+
+    const unsigned seed = cfg.seed != 0 ? cfg.seed : std::random_device{}();
+    std::default_random_engine eng{seed};
+    std::uniform_real_distribution<double> dist(-1, 1);
     // Inizializzazione boids con posizioni e velocità casuali
     std::vector<bd::Boid> initials;
 
-    auto random_boid = [&dist, &eng]() {
-      double x  = std::fabs(dist(eng) * bd::Movement::screen_width);
-      double y  = std::fabs(dist(eng) * bd::Movement::screen_height);
+    auto random_boid = [&dist, &eng, &cfg]() {
+      double x  = std::fabs(dist(eng) * cfg.world_width);
+      double y  = std::fabs(dist(eng) * cfg.world_height);
       double vx = dist(eng) * (bd::Movement::max_speed / std::sqrt(2));
       double vy = dist(eng) * (bd::Movement::max_speed / std::sqrt(2));
       return bd::Boid{x, y, vx, vy};
     };
 
-    for (size_t i = 0; i < n_b; ++i) {
+    if (cfg.three_d) {
+      std::vector<bd::Boid3> initials3;
+      initials3.reserve(cfg.n_boids);
+      for (size_t i = 0; i < cfg.n_boids; ++i) {
+        const bd::Boid b2 = random_boid();
+        const double z    = std::fabs(dist(eng) * cfg.world_depth);
+        const double vz =
+            dist(eng) * (bd::Movement::max_speed / std::sqrt(3));
+        initials3.push_back({{b2.pos[0], b2.pos[1], z},
+                             {b2.vel[0], b2.vel[1], vz}});
+      }
+      run_3d(cfg, initials3);
+      return 0;
+    }
+
+    initials.reserve(cfg.n_boids);
+    for (size_t i = 0; i < cfg.n_boids; ++i) {
       initials.emplace_back(random_boid());
+      initials.back().species = i % cfg.n_species;
+    }
+    if (cfg.threading == bd::ThreadingMode::shared_memory
+        || cfg.threading == bd::ThreadingMode::sockets) {
+      run_distributed(initials, cfg);
+      return 0;
+    }
+    if (cfg.fixed_point) {
+      run_fixed(initials, cfg);
+      return 0;
+    }
+
+    const bd::Position world{cfg.world_width, cfg.world_height};
+    bd::Movement mov(initials, cfg.d, cfg.d_s, cfg.s, cfg.a, cfg.c, world);
+    configure(mov, cfg);
+    for (size_t i = 0; i < cfg.n_predators; ++i) {
+      const bd::Boid b = random_boid();
+      mov.add_predator(bd::Boid{b.pos[0], b.pos[1]});
+    }
+    bd::FlockRenderer renderer(world, cfg.window_width, cfg.window_height,
+                               bd::Movement::max_speed, cfg.lod_threshold);
+    std::unique_ptr<bd::FrameRecorder> recorder;
+    if (!cfg.record_path.empty())
+      recorder = std::make_unique<bd::FrameRecorder>(
+          cfg.record_path, cfg.record_format, cfg.window_width,
+          cfg.window_height, cfg.record_stride);
+    if (cfg.headless) {
+      run_headless(mov, cfg, renderer, recorder.get());
+      return 0;
     }
 
-    bd::Movement mov(initials, d, d_s, s, a, c);
-    sf::RenderWindow window(
-        sf::VideoMode(bd::Movement::screen_width, bd::Movement::screen_height),
-        "Boids Simulation");
-    const int FPS = 90;
-    window.setFramerateLimit(FPS);
+    sf::RenderWindow window(sf::VideoMode(cfg.window_width, cfg.window_height),
+                            "Boids Simulation");
+    const int FPS = cfg.fps;
+    window.setFramerateLimit(static_cast<unsigned>(FPS));
+
+    // frecce per spostarsi, rotella per lo zoom, F per seguire il gruppo
+    // al centro dello schermo, C per tornare alla vista intera
+    const bd::Position screen{static_cast<double>(cfg.window_width),
+                              static_cast<double>(cfg.window_height)};
+    bd::Camera camera(world, screen);
+    bool follow_group      = false;
+    const double pan_speed = 800.; // pixel al secondo
+    std::vector<size_t> visible;
+    visible.reserve(cfg.n_boids);
 
     sf::Vector2i mouse_position;
     bool is_mouse_pressed = false;
@@ -108,15 +265,44 @@ int main()
             is_mouse_pressed = false;
           break;
 
+        case sf::Event::MouseWheelScrolled:
+          camera.zoom_at(event.mouseWheelScroll.delta > 0 ? 1.25 : 0.8,
+                         {static_cast<double>(event.mouseWheelScroll.x),
+                          static_cast<double>(event.mouseWheelScroll.y)});
+          break;
+
+        case sf::Event::KeyPressed:
+          if (event.key.code == sf::Keyboard::F)
+            follow_group = !follow_group;
+          else if (event.key.code == sf::Keyboard::C) {
+            follow_group = false;
+            camera.reset();
+          }
+          break;
+
         default:
           break;
         }
       }
 
-      mov.set_mouse_force(sf::Vector2f(static_cast<float>(mouse_position.x),
-                                       static_cast<float>(mouse_position.y)),
+      // il mouse agisce nel punto del mondo sotto il puntatore
+      const bd::Position mouse_world =
+          camera.to_world({static_cast<double>(mouse_position.x),
+                           static_cast<double>(mouse_position.y)});
+      mov.set_mouse_force(sf::Vector2f(static_cast<float>(mouse_world[0]),
+                                       static_cast<float>(mouse_world[1])),
                           is_mouse_pressed, switch_mouse_force);
 
+      const double pan = pan_speed * dt;
+      if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
+        camera.pan(-pan, 0.);
+      if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
+        camera.pan(pan, 0.);
+      if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
+        camera.pan(0., -pan);
+      if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+        camera.pan(0., pan);
+
       // generatore di boids
       if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space)) {
         mov.push_back_(random_boid());
@@ -125,31 +311,60 @@ int main()
       if (sf::Keyboard::isKeyPressed(sf::Keyboard::R)) {
         mov.remove_();
       }
+      // aggiunge e rimuove i predatori (nella posizione del mouse)
+      if (sf::Keyboard::isKeyPressed(sf::Keyboard::P)) {
+        mov.add_predator(bd::Boid{mouse_world[0], mouse_world[1]});
+      }
+      if (sf::Keyboard::isKeyPressed(sf::Keyboard::O)) {
+        mov.remove_predator();
+      }
 
       mov.update(frame, dt);
 
+      if (follow_group) {
+        const sf::FloatRect seen = camera.visible_rect();
+        const std::optional<bd::Position> group = mov.group_center(
+            camera.get_center(), std::min(seen.width, seen.height) / 4.);
+        if (group)
+          camera.follow(*group, 0.1);
+      }
+
       window.clear(sf::Color::Black);
+      window.setView(camera.view());
+      mov.draw_obstacles(window);
 
       // Verifica se il mouse è visivamente dentro la finestra
       const bool mouse_in_window =
           mouse_position.x >= bd::Movement::edge
           && mouse_position.x
-                 <= (bd::Movement::screen_width - bd::Movement::edge)
+                 <= static_cast<int>(cfg.window_width) - bd::Movement::edge
           && mouse_position.y >= bd::Movement::edge
           && mouse_position.y
-                 <= (bd::Movement::screen_height - bd::Movement::edge);
+                 <= static_cast<int>(cfg.window_height) - bd::Movement::edge;
 
       // Disegna il raggio della forza del mouse se attiva
       if (mov.is_mouse_force_active() && mouse_in_window) {
-        mov.draw_mouse(mouse_position, is_mouse_pressed, window);
+        mov.draw_mouse(sf::Vector2i(static_cast<int>(mouse_world[0]),
+                                    static_cast<int>(mouse_world[1])),
+                       is_mouse_pressed, window);
       }
 
-      // Disegna ogni boid con colore in base alla velocità
-      for (const bd::Boid& b : mov.get_boids()) {
-        mov.draw_boids(b.pos, b.vel, window);
+      // Disegna lo stormo: solo i boids inquadrati, colorati in base alla
+      // velocità, o la mappa di densità se sono troppi
+      mov.visible_boids(camera.visible_rect(), visible);
+      renderer.draw(mov.get_boids(), window, mov.get_scheduler(), &visible,
+                    &mov.get_speeds());
+      for (const bd::Boid& pr : mov.get_predators()) {
+        mov.draw_predator(pr.pos, window);
       }
 
       window.display();
+      if (recorder != nullptr && recorder->wants(frame))
+        recorder->submit(frame, renderer.render(mov.get_boids(),
+                                                mov.get_predators(),
+                                                camera.view(),
+                                                mov.get_scheduler(),
+                                                &mov.get_speeds()));
     }
     return 0;
   }
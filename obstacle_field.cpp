@@ -0,0 +1,188 @@
+#include "obstacle_field.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace bd {
+
+namespace {
+// distanza tra p e il segmento ab
+double segment_distance(const Position& p, const Position& a,
+                        const Position& b)
+{
+  const double ex  = b[0] - a[0];
+  const double ey  = b[1] - a[1];
+  const double len = ex * ex + ey * ey;
+  double t         = 0.;
+  if (len > 0.)
+    t = std::clamp(((p[0] - a[0]) * ex + (p[1] - a[1]) * ey) / len, 0., 1.);
+  const double dx = p[0] - (a[0] + t * ex);
+  const double dy = p[1] - (a[1] + t * ey);
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+double circle_distance(const Position& p, const ObstacleField::Circle& c)
+{
+  return std::hypot(p[0] - c.center[0], p[1] - c.center[1]) - c.radius;
+}
+
+// distanza con segno da un poligono chiuso (regola pari-dispari)
+double polygon_distance(const Position& p, const ObstacleField::Polygon& poly)
+{
+  double dist = std::numeric_limits<double>::max();
+  bool inside = false;
+  for (size_t i = 0, j = poly.size() - 1; i < poly.size(); j = i++) {
+    const Position& a = poly[i];
+    const Position& b = poly[j];
+    dist              = std::min(dist, segment_distance(p, a, b));
+    if ((a[1] > p[1]) != (b[1] > p[1])
+        && p[0] < (b[0] - a[0]) * (p[1] - a[1]) / (b[1] - a[1]) + a[0])
+      inside = !inside;
+  }
+  return inside ? -dist : dist;
+}
+} // namespace
+
+void ObstacleField::add_circle(const Position& center, double radius)
+{
+  if (radius <= 0.)
+    throw std::invalid_argument("Il raggio dell'ostacolo deve essere positivo");
+  circles.push_back({center, radius});
+  sdf.clear();
+}
+
+void ObstacleField::add_polygon(const Polygon& vertices)
+{
+  if (vertices.size() < 3)
+    throw std::invalid_argument("Un poligono richiede almeno 3 vertici");
+  polygons.push_back(vertices);
+  sdf.clear();
+}
+
+void ObstacleField::add_wall(const Position& a, const Position& b)
+{
+  walls.push_back({a, b});
+  sdf.clear();
+}
+
+const std::vector<ObstacleField::Circle>& ObstacleField::get_circles() const
+{
+  return circles;
+}
+
+const std::vector<ObstacleField::Polygon>& ObstacleField::get_polygons() const
+{
+  return polygons;
+}
+
+const std::vector<ObstacleField::Wall>& ObstacleField::get_walls() const
+{
+  return walls;
+}
+
+bool ObstacleField::empty() const
+{
+  return circles.empty() && polygons.empty() && walls.empty();
+}
+
+double ObstacleField::exact_distance(const Position& p) const
+{
+  double dist = std::numeric_limits<double>::max();
+  for (const Circle& c : circles)
+    dist = std::min(dist, circle_distance(p, c));
+  for (const Polygon& poly : polygons)
+    dist = std::min(dist, polygon_distance(p, poly));
+  for (const Wall& w : walls)
+    dist = std::min(dist, segment_distance(p, w.a, w.b));
+  return dist;
+}
+
+template <class F>
+void ObstacleField::splat(const Position& lo, const Position& hi, F&& f)
+{
+  auto to_node = [this](double v, size_t n) {
+    const double i = std::clamp(v / res, 0., static_cast<double>(n - 1));
+    return static_cast<size_t>(i);
+  };
+  const size_t ix_0 = to_node(lo[0] - band, nx);
+  const size_t ix_1 = to_node(hi[0] + band + res, nx);
+  const size_t iy_0 = to_node(lo[1] - band, ny);
+  const size_t iy_1 = to_node(hi[1] + band + res, ny);
+  for (size_t iy = iy_0; iy <= iy_1; ++iy) {
+    for (size_t ix = ix_0; ix <= ix_1; ++ix) {
+      const Position p{static_cast<double>(ix) * res,
+                       static_cast<double>(iy) * res};
+      double& v = node(ix, iy);
+      v         = std::min(v, f(p));
+    }
+  }
+}
+
+// l'unione degli ostacoli ha come distanza il minimo delle distanze: ogni
+// ostacolo aggiorna solo i nodi entro band dal suo rettangolo di ingombro
+void ObstacleField::bake(double width, double height, double resolution,
+                         double max_distance)
+{
+  if (width <= 0. || height <= 0. || resolution <= 0. || max_distance <= 0.)
+    throw std::invalid_argument("Parametri della griglia degli ostacoli non "
+                                "validi");
+  res  = resolution;
+  band = max_distance;
+  nx   = static_cast<size_t>(std::ceil(width / res)) + 1;
+  ny   = static_cast<size_t>(std::ceil(height / res)) + 1;
+  sdf.assign(nx * ny, band);
+
+  for (const Circle& c : circles) {
+    const Position lo{c.center[0] - c.radius, c.center[1] - c.radius};
+    const Position hi{c.center[0] + c.radius, c.center[1] + c.radius};
+    splat(lo, hi, [&c](const Position& p) { return circle_distance(p, c); });
+  }
+  for (const Polygon& poly : polygons) {
+    Position lo = poly[0];
+    Position hi = poly[0];
+    for (const Position& v : poly) {
+      lo = {std::min(lo[0], v[0]), std::min(lo[1], v[1])};
+      hi = {std::max(hi[0], v[0]), std::max(hi[1], v[1])};
+    }
+    splat(lo, hi,
+          [&poly](const Position& p) { return polygon_distance(p, poly); });
+  }
+  for (const Wall& w : walls) {
+    const Position lo{std::min(w.a[0], w.b[0]), std::min(w.a[1], w.b[1])};
+    const Position hi{std::max(w.a[0], w.b[0]), std::max(w.a[1], w.b[1])};
+    splat(lo, hi,
+          [&w](const Position& p) { return segment_distance(p, w.a, w.b); });
+  }
+  for (double& v : sdf)
+    v = std::min(v, band);
+}
+
+bool ObstacleField::baked() const
+{
+  return !sdf.empty();
+}
+
+double ObstacleField::sample(const Position& p, Velocity& grad) const
+{
+  assert(baked());
+  const double gx = std::clamp(p[0] / res, 0., static_cast<double>(nx - 1));
+  const double gy = std::clamp(p[1] / res, 0., static_cast<double>(ny - 1));
+  const size_t ix = std::min(static_cast<size_t>(gx), nx - 2);
+  const size_t iy = std::min(static_cast<size_t>(gy), ny - 2);
+  const double fx = gx - static_cast<double>(ix);
+  const double fy = gy - static_cast<double>(iy);
+
+  const double v00 = sdf[iy * nx + ix];
+  const double v10 = sdf[iy * nx + ix + 1];
+  const double v01 = sdf[(iy + 1) * nx + ix];
+  const double v11 = sdf[(iy + 1) * nx + ix + 1];
+
+  grad[0] = ((1. - fy) * (v10 - v00) + fy * (v11 - v01)) / res;
+  grad[1] = ((1. - fx) * (v01 - v00) + fx * (v11 - v10)) / res;
+  return (1. - fy) * ((1. - fx) * v00 + fx * v10)
+       + fy * ((1. - fx) * v01 + fx * v11);
+}
+
+} // namespace bd
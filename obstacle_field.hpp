@@ -0,0 +1,73 @@
+#ifndef OBSTACLE_FIELD_HPP
+#define OBSTACLE_FIELD_HPP
+
+#include "boid.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// ostacoli statici (cerchi, poligoni chiusi e muri) cotti una volta in una
+// griglia di distanze con segno: ogni boid campiona distanza e gradiente in
+// O(1), indipendentemente dal numero di ostacoli
+class ObstacleField
+{
+ public:
+  struct Circle
+  {
+    Position center;
+    double radius;
+  };
+  using Polygon = std::vector<Position>;
+  struct Wall
+  {
+    Position a;
+    Position b;
+  };
+
+ private:
+  std::vector<Circle> circles;
+  std::vector<Polygon> polygons;
+  std::vector<Wall> walls;
+
+  double res  = 0.; // passo della griglia
+  double band = 0.; // distanza massima memorizzata
+  size_t nx   = 0;
+  size_t ny   = 0;
+  std::vector<double> sdf; // valori sui nodi, riga per riga
+
+  double& node(size_t ix, size_t iy)
+  {
+    return sdf[iy * nx + ix];
+  }
+  // aggiorna i nodi entro band dal rettangolo [lo, hi] con la distanza f
+  template <class F>
+  void splat(const Position& lo, const Position& hi, F&& f);
+
+ public:
+  void add_circle(const Position& center, double radius);
+  // poligono chiuso, interno a distanza negativa
+  void add_polygon(const Polygon& vertices);
+  // muro sottile tra a e b
+  void add_wall(const Position& a, const Position& b);
+
+  const std::vector<Circle>& get_circles() const;
+  const std::vector<Polygon>& get_polygons() const;
+  const std::vector<Wall>& get_walls() const;
+  bool empty() const;
+
+  // distanza con segno esatta, in O(numero di ostacoli)
+  double exact_distance(const Position& p) const;
+
+  // cuoce gli ostacoli in una griglia width x height di passo resolution;
+  // oltre max_distance dagli ostacoli il valore resta max_distance
+  void bake(double width, double height, double resolution,
+            double max_distance);
+  bool baked() const;
+
+  // distanza con segno interpolata bilinearmente e suo gradiente
+  double sample(const Position& p, Velocity& grad) const;
+};
+
+} // namespace bd
+#endif
@@ -0,0 +1,139 @@
+#include "quadtree.hpp"
+#include <cassert>
+#include <cmath>
+
+namespace bd {
+
+void QuadTree::build(const std::vector<Boid>& b)
+{
+  boids = &b;
+  nodes.clear();
+  index.resize(b.size());
+  if (b.empty())
+    return;
+
+  Node root{b[0].pos[0], b[0].pos[1], b[0].pos[0], b[0].pos[1], {}, 0,
+            b.size(),    -1};
+  for (size_t i = 0; i < b.size(); ++i) {
+    index[i] = i;
+    root.x0  = std::min(root.x0, b[i].pos[0]);
+    root.y0  = std::min(root.y0, b[i].pos[1]);
+    root.x1  = std::max(root.x1, b[i].pos[0]);
+    root.y1  = std::max(root.y1, b[i].pos[1]);
+    add_inplace(root.sums.pos_sum, b[i].pos);
+    add_inplace(root.sums.vel_sum, b[i].vel);
+  }
+  root.sums.count = static_cast<int>(b.size());
+  nodes.push_back(root);
+  split(0, 0);
+}
+
+// divide ricorsivamente il nodo in 4 quadranti finché restano pochi boids
+void QuadTree::split(size_t node, int depth)
+{
+  const Node n = nodes[node];
+  if (n.end - n.begin <= leaf_size || depth >= max_depth)
+    return;
+
+  const double mx = 0.5 * (n.x0 + n.x1);
+  const double my = 0.5 * (n.y0 + n.y1);
+  auto first      = index.begin() + static_cast<std::ptrdiff_t>(n.begin);
+  auto last       = index.begin() + static_cast<std::ptrdiff_t>(n.end);
+  const std::vector<Boid>& b = *boids;
+
+  // ordina gli indici per quadrante: (basso, sx), (basso, dx), (alto, sx),
+  // (alto, dx)
+  auto mid_y = std::partition(first, last,
+                              [&](size_t i) { return b[i].pos[1] < my; });
+  auto low_x = std::partition(first, mid_y,
+                              [&](size_t i) { return b[i].pos[0] < mx; });
+  auto up_x  = std::partition(mid_y, last,
+                              [&](size_t i) { return b[i].pos[0] < mx; });
+
+  const std::array<size_t, 5> cut{
+      n.begin, static_cast<size_t>(low_x - index.begin()),
+      static_cast<size_t>(mid_y - index.begin()),
+      static_cast<size_t>(up_x - index.begin()), n.end};
+  const std::array<std::array<double, 4>, 4> box{{{n.x0, n.y0, mx, my},
+                                                  {mx, n.y0, n.x1, my},
+                                                  {n.x0, my, mx, n.y1},
+                                                  {mx, my, n.x1, n.y1}}};
+
+  const size_t first_child = nodes.size();
+  nodes[node].child        = static_cast<int>(first_child);
+  for (size_t q = 0; q < 4; ++q) {
+    Node c{box[q][0], box[q][1], box[q][2], box[q][3], {}, cut[q], cut[q + 1],
+           -1};
+    for (size_t k = c.begin; k < c.end; ++k) {
+      add_inplace(c.sums.pos_sum, b[index[k]].pos);
+      add_inplace(c.sums.vel_sum, b[index[k]].vel);
+    }
+    c.sums.count = static_cast<int>(c.end - c.begin);
+    nodes.push_back(c);
+  }
+  for (size_t q = 0; q < 4; ++q)
+    split(first_child + q, depth + 1);
+}
+
+NeighborSums QuadTree::neighbor_sums(const Position& p, double d,
+                                     double theta) const
+{
+  NeighborSums res;
+  if (nodes.empty())
+    return res;
+
+  const double d2 = d * d;
+
+  VisitStack stack;
+  stack.push(0);
+  while (!stack.empty()) {
+    const Node& n = nodes[stack.pop()];
+    if (n.sums.count == 0 || min_dist2(n, p) >= d2)
+      continue;
+
+    // nodo interamente dentro il raggio: contributo esatto in blocco
+    const double fx = std::max(std::fabs(p[0] - n.x0), std::fabs(p[0] - n.x1));
+    const double fy = std::max(std::fabs(p[1] - n.y0), std::fabs(p[1] - n.y1));
+    if (fx * fx + fy * fy < d2) {
+      add_inplace(res, n.sums);
+      continue;
+    }
+
+    if (n.child < 0) {
+      for (size_t k = n.begin; k < n.end; ++k) {
+        const Boid& other = (*boids)[index[k]];
+        const double ox   = other.pos[0] - p[0];
+        const double oy   = other.pos[1] - p[1];
+        if (ox * ox + oy * oy < d2) {
+          add_inplace(res.pos_sum, other.pos);
+          add_inplace(res.vel_sum, other.vel);
+          ++res.count;
+        }
+      }
+      continue;
+    }
+
+    // nodo lontano a cavallo del bordo: si approssima col centro di massa,
+    // mai però il nodo che contiene p
+    const bool contains_p =
+        p[0] >= n.x0 && p[0] <= n.x1 && p[1] >= n.y0 && p[1] <= n.y1;
+    if (!contains_p && theta > 0.) {
+      const double cnt  = n.sums.count;
+      const double cx   = n.sums.pos_sum[0] / cnt - p[0];
+      const double cy   = n.sums.pos_sum[1] / cnt - p[1];
+      const double dist = cx * cx + cy * cy;
+      const double size = std::max(n.x1 - n.x0, n.y1 - n.y0);
+      if (size * size < theta * theta * dist) {
+        if (dist < d2)
+          add_inplace(res, n.sums);
+        continue;
+      }
+    }
+    for (int q = 0; q < 4; ++q)
+      stack.push(static_cast<size_t>(n.child + q));
+  }
+  assert(res.count >= 0);
+  return res;
+}
+
+} // namespace bd
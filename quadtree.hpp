@@ -0,0 +1,111 @@
+#ifndef QUADTREE_HPP
+#define QUADTREE_HPP
+
+#include "boid.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace bd {
+
+// quadtree di Barnes-Hut: ogni nodo conserva le somme dei boids che contiene,
+// così i nodi lontani possono contribuire a coesione e allineamento in blocco
+class QuadTree
+{
+  struct Node
+  {
+    double x0, y0, x1, y1; // estremi del rettangolo del nodo
+    NeighborSums sums;
+    size_t begin, end;     // intervallo in index
+    int child = -1;        // indice del primo dei 4 figli, -1 se foglia
+  };
+
+  std::vector<Node> nodes;
+  std::vector<size_t> index; // indici dei boids ordinati per nodo
+  const std::vector<Boid>* boids = nullptr;
+
+  static constexpr size_t leaf_size = 8;
+  static constexpr int max_depth    = 16;
+
+  // pila delle visite in profondità sullo stack della chiamata, senza
+  // allocazioni: sotto il nodo corrente restano al più 3 fratelli per
+  // livello, più i 4 figli appena aggiunti
+  class VisitStack
+  {
+    std::array<size_t, 3 * max_depth + 4> items;
+    size_t top = 0;
+
+   public:
+    bool empty() const
+    {
+      return top == 0;
+    }
+    void push(size_t node)
+    {
+      assert(top < items.size());
+      items[top++] = node;
+    }
+    size_t pop()
+    {
+      return items[--top];
+    }
+  };
+
+  void split(size_t node, int depth);
+  // distanza al quadrato tra p e il punto più vicino del rettangolo del nodo
+  static double min_dist2(const Node& n, const Position& p)
+  {
+    const double dx = p[0] < n.x0 ? n.x0 - p[0] : std::max(p[0] - n.x1, 0.);
+    const double dy = p[1] < n.y0 ? n.y0 - p[1] : std::max(p[1] - n.y1, 0.);
+    return dx * dx + dy * dy;
+  }
+
+ public:
+  void build(const std::vector<Boid>& b);
+  bool empty() const
+  {
+    return nodes.empty();
+  }
+
+  // somme dei boids entro d da p (p compreso); i nodi che intersecano il
+  // bordo del raggio e hanno apertura size/dist < theta sono inclusi o
+  // esclusi in blocco in base al loro centro di massa
+  NeighborSums neighbor_sums(const Position& p, double d, double theta) const;
+
+  // visita esatta dei boids entro r da p (usata per la separazione),
+  // f riceve l'indice del boid
+  template <class F>
+  void for_each_within(const Position& p, double r, F&& f) const;
+};
+
+template <class F>
+void QuadTree::for_each_within(const Position& p, double r, F&& f) const
+{
+  if (nodes.empty())
+    return;
+  const double r2 = r * r;
+  VisitStack stack;
+  stack.push(0);
+  while (!stack.empty()) {
+    const Node& n = nodes[stack.pop()];
+    if (n.sums.count == 0 || min_dist2(n, p) >= r2)
+      continue;
+    if (n.child < 0) {
+      for (size_t k = n.begin; k < n.end; ++k) {
+        const Boid& other = (*boids)[index[k]];
+        const double ox   = other.pos[0] - p[0];
+        const double oy   = other.pos[1] - p[1];
+        if (ox * ox + oy * oy < r2)
+          f(index[k]);
+      }
+      continue;
+    }
+    for (int q = 0; q < 4; ++q)
+      stack.push(static_cast<size_t>(n.child + q));
+  }
+}
+
+} // namespace bd
+#endif
@@ -0,0 +1,149 @@
+#include "recorder.hpp"
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace bd {
+
+FrameRecorder::FrameRecorder(const std::string& path_, FrameFormat format_,
+                             unsigned width_, unsigned height_, int stride_,
+                             size_t n_threads, size_t max_pending_)
+    : path{path_}
+    , format{format_}
+    , width{width_}
+    , height{height_}
+    , stride{stride_}
+    , max_pending{max_pending_}
+{
+  if (width == 0 || height == 0)
+    throw std::invalid_argument("Dimensioni dei frame non valide");
+  if (stride < 1)
+    throw std::invalid_argument("Il passo di registrazione deve essere "
+                                "almeno 1");
+  if (n_threads == 0 || max_pending == 0)
+    throw std::invalid_argument("Servono almeno un thread e un frame in coda");
+  if (format == FrameFormat::raw_rgb) {
+    stream.open(path, std::ios::binary | std::ios::trunc);
+    if (!stream)
+      throw std::runtime_error("Impossibile aprire " + path);
+  }
+  for (size_t k = 0; k < n_threads; ++k)
+    workers.emplace_back([this]() { worker_loop(); });
+}
+
+FrameRecorder::~FrameRecorder()
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    stop = true;
+  }
+  wake.notify_all();
+  for (std::thread& t : workers)
+    t.join();
+}
+
+bool FrameRecorder::wants(int frame) const
+{
+  return frame % stride == 0;
+}
+
+bool FrameRecorder::submit(int frame, const std::vector<sf::Uint8>& rgba)
+{
+  if (rgba.size() != size_t{width} * height * 4)
+    throw std::invalid_argument("Dimensione del frame non valida");
+  {
+    std::lock_guard<std::mutex> lock(m);
+    if (queue.size() + in_flight >= max_pending) {
+      ++n_dropped;
+      return false;
+    }
+    queue.push_back({frame, next_seq++, rgba});
+  }
+  wake.notify_one();
+  return true;
+}
+
+void FrameRecorder::worker_loop()
+{
+  std::unique_lock<std::mutex> lock(m);
+  while (true) {
+    wake.wait(lock, [this]() { return stop || !queue.empty(); });
+    if (queue.empty())
+      return; // stop, e nessun frame rimasto
+    Job job = std::move(queue.front());
+    queue.pop_front();
+    ++in_flight;
+    lock.unlock();
+    std::exception_ptr failure;
+    try {
+      write(job);
+    } catch (...) {
+      failure = std::current_exception();
+    }
+    lock.lock();
+    --in_flight;
+    if (failure && !error)
+      error = failure;
+    else if (!failure)
+      ++n_written;
+    progress.notify_all();
+  }
+}
+
+void FrameRecorder::write(Job& job)
+{
+  if (format == FrameFormat::png) {
+    sf::Image image;
+    image.create(width, height, job.rgba.data());
+    std::ostringstream name;
+    name << path << '_' << std::setw(6) << std::setfill('0') << job.frame
+         << ".png";
+    if (!image.saveToFile(name.str()))
+      throw std::runtime_error("Impossibile scrivere " + name.str());
+    return;
+  }
+
+  // RGBA -> RGB sul posto, fuori dal lock
+  const size_t n_pixels = size_t{width} * height;
+  for (size_t p = 0; p < n_pixels; ++p) {
+    job.rgba[3 * p]     = job.rgba[4 * p];
+    job.rgba[3 * p + 1] = job.rgba[4 * p + 1];
+    job.rgba[3 * p + 2] = job.rgba[4 * p + 2];
+  }
+  std::unique_lock<std::mutex> lock(m);
+  progress.wait(lock, [&]() { return next_write == job.seq; });
+  stream.write(reinterpret_cast<const char*>(job.rgba.data()),
+               static_cast<std::streamsize>(3 * n_pixels));
+  const bool ok = static_cast<bool>(stream);
+  ++next_write; // anche in caso di errore, per non bloccare i successivi
+  progress.notify_all();
+  if (!ok)
+    throw std::runtime_error("Impossibile scrivere " + path);
+}
+
+void FrameRecorder::flush()
+{
+  std::unique_lock<std::mutex> lock(m);
+  progress.wait(lock, [this]() { return queue.empty() && in_flight == 0; });
+  if (format == FrameFormat::raw_rgb)
+    stream.flush();
+  if (error) {
+    std::exception_ptr e = error;
+    error                = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+size_t FrameRecorder::written()
+{
+  std::lock_guard<std::mutex> lock(m);
+  return n_written;
+}
+
+size_t FrameRecorder::dropped()
+{
+  std::lock_guard<std::mutex> lock(m);
+  return n_dropped;
+}
+
+} // namespace bd
@@ -0,0 +1,79 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bd {
+
+enum class FrameFormat
+{
+  raw_rgb, // un solo file con i frame RGB a 8 bit uno dopo l'altro
+  png,     // un file per frame: <path>_<frame a 6 cifre>.png
+};
+
+// salva i frame renderizzati ogni stride frame: submit copia i pixel e
+// ritorna subito, la codifica e la scrittura avvengono su n_threads thread;
+// nel formato raw i frame vengono comunque scritti in ordine. Con più di
+// max_pending frame in sospeso il nuovo frame viene scartato e contato,
+// così la simulazione non attende mai il disco
+class FrameRecorder
+{
+  struct Job
+  {
+    int frame  = 0;
+    size_t seq = 0; // ordine di scrittura
+    std::vector<sf::Uint8> rgba;
+  };
+
+  std::string path;
+  FrameFormat format;
+  unsigned width;
+  unsigned height;
+  int stride;
+  size_t max_pending;
+  std::ofstream stream;
+
+  std::mutex m;
+  std::condition_variable wake;     // nuovi frame o arresto
+  std::condition_variable progress; // un frame è stato scritto
+  std::deque<Job> queue;
+  size_t in_flight  = 0;
+  size_t next_seq   = 0;
+  size_t next_write = 0;
+  size_t n_written  = 0;
+  size_t n_dropped  = 0;
+  bool stop         = false;
+  std::exception_ptr error;
+  std::vector<std::thread> workers;
+
+  void worker_loop();
+  void write(Job& job);
+
+ public:
+  FrameRecorder(const std::string& path_, FrameFormat format_,
+                unsigned width_, unsigned height_, int stride_ = 1,
+                size_t n_threads = 2, size_t max_pending_ = 16);
+  ~FrameRecorder();
+  FrameRecorder(const FrameRecorder&)            = delete;
+  FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+  bool wants(int frame) const;
+  // rgba: width * height * 4 byte; falso se il frame è stato scartato
+  bool submit(int frame, const std::vector<sf::Uint8>& rgba);
+  // attende i frame in sospeso; rilancia il primo errore di scrittura
+  void flush();
+  size_t written();
+  size_t dropped();
+};
+
+} // namespace bd
+#endif
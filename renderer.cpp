@@ -0,0 +1,278 @@
+#include "renderer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+namespace bd {
+
+namespace {
+// numero di boids per pixel a cui la mappa raggiunge la luminosità piena
+constexpr double saturation = 32.;
+
+struct ViewRect
+{
+  double left, top, w, h;
+};
+
+ViewRect view_rect(const sf::View& view)
+{
+  const sf::Vector2f c = view.getCenter();
+  const sf::Vector2f s = view.getSize();
+  return {c.x - s.x / 2., c.y - s.y / 2., s.x, s.y};
+}
+
+// moduli già calcolati, se ce n'è uno per boid
+const std::vector<float>* usable(const std::vector<float>* speeds, size_t n)
+{
+  return speeds != nullptr && speeds->size() == n ? speeds : nullptr;
+}
+
+float speed_of(const std::vector<Boid>& b, const std::vector<float>* speeds,
+               size_t i)
+{
+  return speeds != nullptr
+           ? (*speeds)[i]
+           : static_cast<float>(std::hypot(b[i].vel[0], b[i].vel[1]));
+}
+
+// stesso colore di Movement::draw_boids: da bianco a rosso con la velocità
+sf::Color speed_color(double speed, double max_speed, double intensity)
+{
+  const double ns = std::min(speed / max_speed, 1.);
+  const auto red  = static_cast<sf::Uint8>(255. * intensity);
+  const auto gb   = static_cast<sf::Uint8>(255. * (1. - ns) * intensity);
+  return sf::Color(red, gb, gb);
+}
+} // namespace
+
+FlockRenderer::FlockRenderer(const Position& world_, unsigned width_,
+                             unsigned height_, double max_speed_,
+                             size_t lod_threshold_)
+    : world{world_}
+    , width{width_}
+    , height{height_}
+    , max_speed{max_speed_}
+    , lod_threshold{lod_threshold_}
+{
+  if (width == 0 || height == 0 || world[0] <= 0. || world[1] <= 0.)
+    throw std::invalid_argument("Dimensioni della mappa non valide");
+  if (max_speed <= 0.)
+    throw std::invalid_argument("La velocità massima deve essere positiva");
+  // tutta la memoria della mappa viene riservata qui, non durante i frame
+  const size_t n_pixels = size_t{width} * height;
+  total.assign(n_pixels, 0);
+  pixels.assign(n_pixels * 4, 0);
+}
+
+void FlockRenderer::set_lod_threshold(size_t n)
+{
+  lod_threshold = n;
+}
+
+bool FlockRenderer::uses_heatmap(size_t n_boids, const sf::View& view) const
+{
+  const ViewRect r     = view_rect(view);
+  const double visible = std::min(1., r.w * r.h / (world[0] * world[1]));
+  return static_cast<double>(n_boids) * visible
+       > static_cast<double>(lod_threshold);
+}
+
+void FlockRenderer::rasterize(const std::vector<Boid>& b,
+                              const sf::View& view, TaskScheduler* pool,
+                              const std::vector<size_t>* visible,
+                              const std::vector<float>* speeds_)
+{
+  const std::vector<float>* known = usable(speeds_, b.size());
+  const size_t n_tasks =
+      pool != nullptr ? std::clamp<size_t>(pool->size(), 1, max_tasks) : 1;
+  const size_t n_pixels = total.size();
+  while (counts.size() < n_tasks) {
+    counts.emplace_back(n_pixels, 0);
+    speeds.emplace_back(n_pixels, 0.f);
+  }
+
+  const ViewRect r = view_rect(view);
+  const double sx  = width / r.w;
+  const double sy  = height / r.h;
+  // ogni compito accumula una fetta dei boids nei propri contatori
+  const size_t n_boids = visible != nullptr ? visible->size() : b.size();
+  auto splat           = [&](size_t k) {
+    std::vector<std::uint32_t>& cnt = counts[k];
+    std::vector<float>& spd         = speeds[k];
+    const size_t first              = n_boids * k / n_tasks;
+    const size_t last               = n_boids * (k + 1) / n_tasks;
+    for (size_t j = first; j < last; ++j) {
+      const size_t i = visible != nullptr ? (*visible)[j] : j;
+      const double x = (b[i].pos[0] - r.left) * sx;
+      const double y = (b[i].pos[1] - r.top) * sy;
+      if (!(x >= 0. && y >= 0. && x < width && y < height))
+        continue;
+      const size_t p = static_cast<size_t>(y) * width + static_cast<size_t>(x);
+      ++cnt[p];
+      spd[p] += speed_of(b, known, i);
+    }
+  };
+  // la riduzione procede per strisce di righe e azzera gli accumulatori
+  const size_t n_stripes = n_tasks * 4;
+  auto reduce            = [&](size_t k) {
+    const size_t first = n_pixels * k / n_stripes;
+    const size_t last  = n_pixels * (k + 1) / n_stripes;
+    const double log_sat = std::log1p(saturation);
+    for (size_t p = first; p < last; ++p) {
+      std::uint32_t c = 0;
+      float s         = 0.f;
+      for (size_t t = 0; t < n_tasks; ++t) {
+        c += counts[t][p];
+        s += speeds[t][p];
+        counts[t][p] = 0;
+        speeds[t][p] = 0.f;
+      }
+      total[p]           = c;
+      const double light = std::min(1., std::log1p(c) / log_sat);
+      const sf::Color col =
+          speed_color(c > 0 ? s / static_cast<double>(c) : 0., max_speed,
+                      light);
+      pixels[4 * p]     = col.r;
+      pixels[4 * p + 1] = col.g;
+      pixels[4 * p + 2] = col.b;
+      pixels[4 * p + 3] = 255; // opaco: i pixel vuoti restano neri
+    }
+  };
+
+  if (pool != nullptr && n_tasks > 1) {
+    pool->parallel_for(n_tasks, splat);
+    pool->parallel_for(n_stripes, reduce);
+  } else {
+    splat(0);
+    for (size_t k = 0; k < n_stripes; ++k)
+      reduce(k);
+  }
+}
+
+const std::vector<sf::Uint8>& FlockRenderer::get_pixels() const
+{
+  return pixels;
+}
+
+std::uint32_t FlockRenderer::count_at(unsigned x, unsigned y) const
+{
+  return total[size_t{y} * width + x];
+}
+
+void FlockRenderer::draw(const std::vector<Boid>& b, sf::RenderTarget& target,
+                         TaskScheduler* pool,
+                         const std::vector<size_t>* visible,
+                         const std::vector<float>* speeds_)
+{
+  const sf::View& view = target.getView();
+  // con gli indici visibili il conteggio è esatto, non stimato dall'area
+  const bool heatmap = visible != nullptr ? visible->size() > lod_threshold
+                                          : uses_heatmap(b.size(), view);
+  if (heatmap) {
+    rasterize(b, view, pool, visible, speeds_);
+    if (!texture_ready)
+      texture_ready = texture.create(width, height);
+    texture.update(pixels.data()); // un solo caricamento per frame
+    const ViewRect r = view_rect(view);
+    sf::Sprite sprite(texture);
+    sprite.setPosition(static_cast<float>(r.left), static_cast<float>(r.top));
+    sprite.setScale(static_cast<float>(r.w / width),
+                    static_cast<float>(r.h / height));
+    target.draw(sprite);
+    return;
+  }
+
+  // un quadrato di lato 6 per boid, come il cerchio di raggio 3. I blocchi
+  // sono indipendenti e si dividono tra i thread di pool: per ognuno si
+  // raccolgono i moduli, si calcolano i colori in un ciclo su soli float
+  // (vettorizzabile) e si scrivono i vertici
+  const std::vector<float>* known = usable(speeds_, b.size());
+  const size_t n_boids  = visible != nullptr ? visible->size() : b.size();
+  const size_t n_blocks = (n_boids + quad_block - 1) / quad_block;
+  const auto inv_max    = static_cast<float>(1. / max_speed);
+  quads.resize(n_boids * 4);
+  auto fill = [&](size_t k) {
+    const size_t first = k * quad_block;
+    const size_t count = std::min(quad_block, n_boids - first);
+    std::array<size_t, quad_block> at;
+    std::array<float, quad_block> spd;
+    std::array<sf::Uint8, quad_block> gb;
+    for (size_t j = 0; j < count; ++j) {
+      at[j]  = visible != nullptr ? (*visible)[first + j] : first + j;
+      spd[j] = speed_of(b, known, at[j]);
+    }
+    for (size_t j = 0; j < count; ++j)
+      gb[j] = static_cast<sf::Uint8>(
+          255.f * (1.f - std::min(spd[j] * inv_max, 1.f)));
+    for (size_t j = 0; j < count; ++j) {
+      const Boid& bo      = b[at[j]];
+      const auto x        = static_cast<float>(bo.pos[0]);
+      const auto y        = static_cast<float>(bo.pos[1]);
+      const sf::Color col = sf::Color(255, gb[j], gb[j]);
+      const size_t v      = 4 * (first + j);
+      quads[v]     = sf::Vertex(sf::Vector2f(x, y), col);
+      quads[v + 1] = sf::Vertex(sf::Vector2f(x + 6.f, y), col);
+      quads[v + 2] = sf::Vertex(sf::Vector2f(x + 6.f, y + 6.f), col);
+      quads[v + 3] = sf::Vertex(sf::Vector2f(x, y + 6.f), col);
+    }
+  };
+  if (pool != nullptr && n_blocks > 1) {
+    pool->parallel_for(n_blocks, fill);
+  } else {
+    for (size_t k = 0; k < n_blocks; ++k)
+      fill(k);
+  }
+  target.draw(quads);
+}
+
+const std::vector<sf::Uint8>& FlockRenderer::render(
+    const std::vector<Boid>& b, const std::vector<Boid>& predators,
+    const sf::View& view, TaskScheduler* pool,
+    const std::vector<float>* speeds_)
+{
+  const std::vector<float>* known = usable(speeds_, b.size());
+  const ViewRect r                = view_rect(view);
+  const double sx  = width / r.w;
+  const double sy  = height / r.h;
+  // quadrato di lato side (in unità del mondo) con l'angolo in p
+  auto stamp = [&](const Position& p, double side, const sf::Color& col) {
+    const double x0 = (p[0] - r.left) * sx;
+    const double y0 = (p[1] - r.top) * sy;
+    const double x1 = x0 + std::max(side * sx, 1.);
+    const double y1 = y0 + std::max(side * sy, 1.);
+    if (x1 <= 0. || y1 <= 0. || x0 >= width || y0 >= height)
+      return;
+    const auto px0 = static_cast<size_t>(std::max(x0, 0.));
+    const auto py0 = static_cast<size_t>(std::max(y0, 0.));
+    const auto px1 = static_cast<size_t>(std::min<double>(x1, width));
+    const auto py1 = static_cast<size_t>(std::min<double>(y1, height));
+    for (size_t y = py0; y < py1; ++y) {
+      for (size_t x = px0; x < px1; ++x) {
+        sf::Uint8* out = &pixels[4 * (y * width + x)];
+        out[0]         = col.r;
+        out[1]         = col.g;
+        out[2]         = col.b;
+        out[3]         = 255;
+      }
+    }
+  };
+
+  if (uses_heatmap(b.size(), view)) {
+    rasterize(b, view, pool, nullptr, known);
+  } else {
+    for (size_t p = 0; p < pixels.size(); p += 4) {
+      pixels[p]     = 0;
+      pixels[p + 1] = 0;
+      pixels[p + 2] = 0;
+      pixels[p + 3] = 255;
+    }
+    for (size_t i = 0; i < b.size(); ++i)
+      stamp(b[i].pos, 6., speed_color(speed_of(b, known, i), max_speed, 1.));
+  }
+  for (const Boid& pr : predators)
+    stamp({pr.pos[0] - 5., pr.pos[1] - 5.}, 10., sf::Color(255, 200, 0));
+  return pixels;
+}
+
+} // namespace bd
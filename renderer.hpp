@@ -0,0 +1,78 @@
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include "boid.hpp"
+#include "scheduler.hpp"
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bd {
+
+// disegno dello stormo con livello di dettaglio: finché i boids visibili
+// sono al più lod_threshold ognuno è un quadrato colorato in base alla
+// velocità (un solo draw per tutti), oltre si disegna una mappa di densità
+// con un pixel della texture per pixel della finestra, la luminosità data
+// dal numero di boids e il colore dalla loro velocità media
+class FlockRenderer
+{
+  Position world;
+  unsigned width;
+  unsigned height;
+  double max_speed; // velocità del colore più saturo
+  size_t lod_threshold;
+
+  // accumulatori per compito, sommati pixel per pixel nella riduzione
+  static constexpr size_t max_tasks = 8;
+  std::vector<std::vector<std::uint32_t>> counts;
+  std::vector<std::vector<float>> speeds;
+  std::vector<std::uint32_t> total;
+  std::vector<sf::Uint8> pixels; // RGBA
+  sf::Texture texture;
+  bool texture_ready = false;
+  sf::VertexArray quads{sf::Quads};
+  // boids per blocco nel riempimento dei vertici
+  static constexpr size_t quad_block = 256;
+
+ public:
+  // world: dimensioni del mondo; width x height: risoluzione della mappa,
+  // normalmente quella della finestra
+  FlockRenderer(const Position& world_, unsigned width_, unsigned height_,
+                double max_speed_, size_t lod_threshold_ = 50000);
+
+  void set_lod_threshold(size_t n);
+  // vero se i boids stimati dentro view superano la soglia
+  bool uses_heatmap(size_t n_boids, const sf::View& view) const;
+
+  // accumula la mappa della regione inquadrata da view, in parallelo su
+  // pool se dato; con visible solo i boids di quegli indici. speeds sono
+  // i moduli delle velocità già calcolati (Movement::get_speeds), ignorati
+  // se non hanno un elemento per boid
+  void rasterize(const std::vector<Boid>& b, const sf::View& view,
+                 TaskScheduler* pool                = nullptr,
+                 const std::vector<size_t>* visible = nullptr,
+                 const std::vector<float>* speeds   = nullptr);
+  const std::vector<sf::Uint8>& get_pixels() const;
+  std::uint32_t count_at(unsigned x, unsigned y) const;
+
+  // visible: indici dei boids inquadrati (Movement::visible_boids), così
+  // il costo segue i boids a schermo e non l'intero stormo
+  void draw(const std::vector<Boid>& b, sf::RenderTarget& target,
+            TaskScheduler* pool                = nullptr,
+            const std::vector<size_t>* visible = nullptr,
+            const std::vector<float>* speeds   = nullptr);
+
+  // disegno interamente su CPU nel buffer RGBA di get_pixels, senza
+  // finestra né contesto grafico: la mappa o i quadrati dei boids (e dei
+  // predatori) su fondo nero
+  const std::vector<sf::Uint8>& render(const std::vector<Boid>& b,
+                                       const std::vector<Boid>& predators,
+                                       const sf::View& view,
+                                       TaskScheduler* pool = nullptr,
+                                       const std::vector<float>* speeds =
+                                           nullptr);
+};
+
+} // namespace bd
+#endif
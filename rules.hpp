@@ -0,0 +1,95 @@
+#ifndef RULES_HPP
+#define RULES_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace bd {
+
+// regole del moto su vettori di N componenti di tipo T (double oppure
+// Fixed): le usano sia Movement (2D, double) sia BasicMovement, così le
+// due versioni del modello non possono divergere
+template <size_t N, class T>
+T norm2(const std::array<T, N>& v)
+{
+  T res{};
+  for (size_t k = 0; k < N; ++k)
+    res += v[k] * v[k];
+  return res;
+}
+
+template <size_t N, class T>
+T dist2(const std::array<T, N>& p, const std::array<T, N>& q)
+{
+  T res{};
+  for (size_t k = 0; k < N; ++k)
+    res += (p[k] - q[k]) * (p[k] - q[k]);
+  return res;
+}
+
+// Separazione: allontana se più vicini di d_s
+template <size_t N, class T>
+std::array<T, N> separation(const std::array<T, N>& pos_i,
+                            const std::array<T, N>& pos_j, T d_s, T s)
+{
+  std::array<T, N> res{};
+  if (dist2(pos_i, pos_j) < d_s * d_s) {
+    for (size_t k = 0; k < N; ++k)
+      res[k] = -s * (pos_j[k] - pos_i[k]);
+  }
+  return res;
+}
+
+// Allineamento: avvicina alla velocità media dei vicini
+template <size_t N, class T>
+std::array<T, N> alignment(const std::array<T, N>& vel_i,
+                           const std::array<T, N>& mean_vel, T a)
+{
+  std::array<T, N> res;
+  for (size_t k = 0; k < N; ++k)
+    res[k] = a * (mean_vel[k] - vel_i[k]);
+  return res;
+}
+
+// Coesione: avvicina al centro dei vicini
+template <size_t N, class T>
+std::array<T, N> cohesion(const std::array<T, N>& pos_i,
+                          const std::array<T, N>& center_mass, T c)
+{
+  std::array<T, N> res;
+  for (size_t k = 0; k < N; ++k)
+    res[k] = c * (center_mass[k] - pos_i[k]);
+  return res;
+}
+
+// effetto pacman su ogni asse del mondo [0, world)
+template <size_t N, class T>
+void wrap(std::array<T, N>& p, const std::array<T, N>& world)
+{
+  for (size_t k = 0; k < N; ++k) {
+    if (p[k] >= world[k])
+      p[k] -= world[k];
+    if (p[k] < T{})
+      p[k] += world[k];
+  }
+}
+
+// limita v a max_speed e ne restituisce il modulo finale
+template <size_t N, class T>
+T limit_speed(std::array<T, N>& v, T max_speed)
+{
+  // per Fixed la radice è quella intera di fixed_point.hpp
+  using std::sqrt;
+  const T speed = sqrt(norm2(v));
+  if (speed > max_speed) {
+    const T scale = max_speed / speed;
+    for (T& x : v)
+      x *= scale;
+    return max_speed;
+  }
+  return speed;
+}
+
+} // namespace bd
+#endif
@@ -0,0 +1,123 @@
+#include "scheduler.hpp"
+#include <cassert>
+#include <stdexcept>
+
+namespace bd {
+
+TaskScheduler::TaskScheduler(size_t n_threads)
+{
+  if (n_threads == 0)
+    throw std::invalid_argument("Il numero di thread deve essere positivo");
+  for (size_t id = 0; id < n_threads; ++id)
+    deques.push_back(std::make_unique<WorkStealingDeque<size_t>>());
+  for (size_t id = 1; id < n_threads; ++id)
+    threads.emplace_back([this, id]() { worker_loop(id); });
+}
+
+TaskScheduler::~TaskScheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    stop = true;
+  }
+  wake.notify_all();
+  for (std::thread& t : threads)
+    t.join();
+}
+
+size_t TaskScheduler::size() const
+{
+  return deques.size();
+}
+
+size_t TaskScheduler::steals() const
+{
+  return n_steals.load(std::memory_order_relaxed);
+}
+
+void TaskScheduler::worker_loop(size_t id)
+{
+  std::uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      wake.wait(lock, [&]() { return stop || generation != seen; });
+      if (stop)
+        return;
+      seen = generation;
+    }
+    work(id);
+    std::lock_guard<std::mutex> lock(m);
+    if (--busy == 0)
+      done.notify_all();
+  }
+}
+
+// prima i compiti propri, poi quelli rubati agli altri a partire dal
+// thread successivo, così i ladri non cercano tutti nella stessa deque
+void TaskScheduler::work(size_t id)
+{
+  const size_t n = deques.size();
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    std::optional<size_t> task = deques[id]->pop();
+    for (size_t k = 1; !task && k < n; ++k) {
+      task = deques[(id + k) % n]->steal();
+      if (task)
+        n_steals.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!task) {
+      std::this_thread::yield();
+      continue;
+    }
+    try {
+      (*job)(*task);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m);
+      if (!error)
+        error = std::current_exception();
+    }
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+  }
+}
+
+void TaskScheduler::parallel_for(size_t n_tasks,
+                                 const std::function<void(size_t)>& f)
+{
+  const size_t n = deques.size();
+  if (n == 1 || n_tasks < 2) {
+    for (size_t k = 0; k < n_tasks; ++k)
+      f(k);
+    return;
+  }
+
+  // i thread ausiliari dormono: il chiamante può riempire tutte le deque,
+  // a blocchi contigui così compiti vicini restano sullo stesso thread
+  for (size_t id = 0; id < n; ++id) {
+    const size_t first = n_tasks * id / n;
+    const size_t last  = n_tasks * (id + 1) / n;
+    deques[id]->reserve(last - first);
+    for (size_t k = last; k-- > first;) {
+      [[maybe_unused]] const bool ok = deques[id]->push(k);
+      assert(ok);
+    }
+  }
+  job = &f;
+  remaining.store(n_tasks, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(m);
+    busy = n - 1;
+    ++generation;
+  }
+  wake.notify_all();
+  work(0);
+  std::unique_lock<std::mutex> lock(m);
+  done.wait(lock, [this]() { return busy == 0; });
+  job = nullptr;
+  if (error) {
+    std::exception_ptr e = error;
+    error                = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+} // namespace bd
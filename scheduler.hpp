@@ -0,0 +1,136 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace bd {
+
+// deque di Chase-Lev a capacità fissa: il thread proprietario inserisce ed
+// estrae dal fondo, gli altri rubano dalla cima con una compare-exchange
+// (ordini di memoria come in Lê et al., "Correct and efficient
+// work-stealing for weak memory models", 2013)
+template <class T>
+class WorkStealingDeque
+{
+  std::unique_ptr<std::atomic<T>[]> buf;
+  std::int64_t mask = -1;
+  std::atomic<std::int64_t> top{0};
+  std::atomic<std::int64_t> bottom{0};
+
+ public:
+  // da chiamare solo quando nessun thread usa la deque
+  void reserve(size_t capacity)
+  {
+    size_t n = 1;
+    while (n < capacity)
+      n *= 2;
+    if (static_cast<std::int64_t>(n) <= mask + 1)
+      return;
+    buf  = std::make_unique<std::atomic<T>[]>(n);
+    mask = static_cast<std::int64_t>(n) - 1;
+    top.store(0, std::memory_order_relaxed);
+    bottom.store(0, std::memory_order_relaxed);
+  }
+
+  // solo il proprietario; falso se la deque è piena
+  bool push(T x)
+  {
+    const std::int64_t b = bottom.load(std::memory_order_relaxed);
+    const std::int64_t t = top.load(std::memory_order_acquire);
+    if (b - t > mask)
+      return false;
+    buf[static_cast<size_t>(b & mask)].store(x, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // solo il proprietario
+  std::optional<T> pop()
+  {
+    const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    T x = buf[static_cast<size_t>(b & mask)].load(std::memory_order_relaxed);
+    if (t == b) {
+      // ultimo elemento: si contende con i ladri
+      const bool won = top.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      if (!won)
+        return std::nullopt;
+    }
+    return x;
+  }
+
+  // qualsiasi thread
+  std::optional<T> steal()
+  {
+    std::int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+      return std::nullopt;
+    T x = buf[static_cast<size_t>(t & mask)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+      return std::nullopt;
+    return x;
+  }
+};
+
+// gruppo di thread persistenti con una deque ciascuno: parallel_for divide
+// i compiti tra le deque e ogni thread, finiti i propri, ruba quelli degli
+// altri. Il thread chiamante partecipa come thread 0. Pensato per i compiti
+// indipendenti di un frame (vicini, statistiche, preparazione del disegno)
+class TaskScheduler
+{
+  std::vector<std::unique_ptr<WorkStealingDeque<size_t>>> deques;
+  std::vector<std::thread> threads;
+
+  std::mutex m;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::uint64_t generation = 0;
+  bool stop                = false;
+  size_t busy              = 0; // thread ausiliari ancora nel compito
+
+  const std::function<void(size_t)>* job = nullptr;
+  std::atomic<size_t> remaining{0};
+  std::atomic<size_t> n_steals{0};
+  std::exception_ptr error;
+
+  void worker_loop(size_t id);
+  void work(size_t id);
+
+ public:
+  explicit TaskScheduler(size_t n_threads);
+  ~TaskScheduler();
+  TaskScheduler(const TaskScheduler&)            = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+  size_t size() const;
+  // esegue f(0), ..., f(n_tasks - 1) e ritorna quando sono tutti finiti;
+  // un'eccezione lanciata da un compito viene rilanciata qui
+  void parallel_for(size_t n_tasks, const std::function<void(size_t)>& f);
+  // compiti rubati dalla creazione dello scheduler
+  size_t steals() const;
+};
+
+} // namespace bd
+#endif
@@ -0,0 +1,116 @@
+#include "shm_ring.hpp"
+#include <atomic>
+#include <bit>
+#include <fcntl.h>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+namespace bd {
+
+// contatori di scrittura e lettura che crescono sempre: la loro differenza
+// è il numero di elementi in coda
+struct ShmRing::Header
+{
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+  std::atomic<bool> closed{false};
+};
+
+static_assert(std::atomic<size_t>::is_always_lock_free
+                  && std::atomic<bool>::is_always_lock_free,
+              "gli atomici in memoria condivisa devono essere lock-free");
+
+namespace {
+// gli elementi partono dalla prima linea di cache dopo l'intestazione
+constexpr size_t slots_offset = 64;
+static_assert(sizeof(std::atomic<size_t>) * 3 <= slots_offset);
+} // namespace
+
+ShmRing::ShmRing(size_t capacity)
+{
+  if (capacity == 0)
+    throw std::invalid_argument("La coda deve avere capacità positiva");
+  const size_t n = std::bit_ceil(capacity);
+  mask           = n - 1;
+  bytes          = slots_offset + n * sizeof(Message);
+
+  // il nome serve solo per creare il segmento: viene rimosso subito e la
+  // memoria resta finché qualche processo la mappa
+  static std::atomic<int> counter{0};
+  const std::string name = "/boids_ring_" + std::to_string(getpid()) + "_"
+                         + std::to_string(counter++);
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    throw std::runtime_error("Impossibile creare la memoria condivisa");
+  shm_unlink(name.c_str());
+  if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Impossibile dimensionare la memoria condivisa");
+  }
+  void* base =
+      mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+    throw std::runtime_error("Impossibile mappare la memoria condivisa");
+
+  hdr   = new (base) Header{};
+  slots = reinterpret_cast<Message*>(static_cast<char*>(base) + slots_offset);
+  std::uninitialized_default_construct_n(slots, n);
+}
+
+ShmRing::~ShmRing()
+{
+  if (hdr != nullptr)
+    munmap(hdr, bytes);
+}
+
+ShmRing::ShmRing(ShmRing&& other) noexcept
+    : hdr{other.hdr}
+    , slots{other.slots}
+    , bytes{other.bytes}
+    , mask{other.mask}
+{
+  other.hdr = nullptr;
+}
+
+size_t ShmRing::capacity() const
+{
+  return mask + 1;
+}
+
+void ShmRing::push(const Message& m)
+{
+  const size_t h = hdr->head.load(std::memory_order_relaxed);
+  while (h - hdr->tail.load(std::memory_order_acquire) > mask) {
+    if (hdr->closed.load(std::memory_order_relaxed))
+      throw std::runtime_error("Coda condivisa chiusa");
+    std::this_thread::yield();
+  }
+  slots[h & mask] = m;
+  hdr->head.store(h + 1, std::memory_order_release);
+}
+
+Message ShmRing::pop()
+{
+  const size_t t = hdr->tail.load(std::memory_order_relaxed);
+  while (hdr->head.load(std::memory_order_acquire) == t) {
+    if (hdr->closed.load(std::memory_order_relaxed))
+      throw std::runtime_error("Coda condivisa chiusa");
+    std::this_thread::yield();
+  }
+  const Message m = slots[t & mask];
+  hdr->tail.store(t + 1, std::memory_order_release);
+  return m;
+}
+
+void ShmRing::close()
+{
+  hdr->closed.store(true, std::memory_order_relaxed);
+}
+
+} // namespace bd
@@ -0,0 +1,44 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include "boid.hpp"
+#include <cstddef>
+
+namespace bd {
+
+// elemento scambiato tra i processi: un boid oppure la fine di un blocco
+struct Message
+{
+  Boid boid;
+  bool last = false;
+};
+
+// coda circolare a produttore e consumatore singoli in memoria condivisa
+// POSIX: va creata prima della fork, così entrambi i processi la vedono;
+// push e pop attendono rispettivamente spazio libero e un elemento
+class ShmRing
+{
+  struct Header;
+  Header* hdr    = nullptr;
+  Message* slots = nullptr;
+  size_t bytes   = 0;
+  size_t mask    = 0;
+
+ public:
+  // capacity viene arrotondata alla potenza di due successiva
+  explicit ShmRing(size_t capacity);
+  ~ShmRing();
+  ShmRing(const ShmRing&)            = delete;
+  ShmRing& operator=(const ShmRing&) = delete;
+  ShmRing(ShmRing&& other) noexcept;
+  ShmRing& operator=(ShmRing&&) = delete;
+
+  size_t capacity() const;
+  void push(const Message& m);
+  Message pop();
+  // sblocca chi attende: push e pop lanciano std::runtime_error
+  void close();
+};
+
+} // namespace bd
+#endif
@@ -0,0 +1,409 @@
+#include "socket_transport.hpp"
+#include "boids_logic.hpp"
+#include <arpa/inet.h>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace bd {
+
+namespace {
+constexpr size_t boid_words  = 6;
+constexpr size_t header_size = 2 * sizeof(std::uint32_t);
+
+using Words = std::array<std::uint64_t, boid_words>;
+
+Words to_words(const Boid& b)
+{
+  return {std::bit_cast<std::uint64_t>(b.pos[0]),
+          std::bit_cast<std::uint64_t>(b.pos[1]),
+          std::bit_cast<std::uint64_t>(b.vel[0]),
+          std::bit_cast<std::uint64_t>(b.vel[1]),
+          std::bit_cast<std::uint64_t>(b.fov),
+          static_cast<std::uint64_t>(b.species)};
+}
+
+Boid from_words(const Words& w)
+{
+  Boid b{std::bit_cast<double>(w[0]), std::bit_cast<double>(w[1]),
+         std::bit_cast<double>(w[2]), std::bit_cast<double>(w[3])};
+  b.fov     = std::bit_cast<double>(w[4]);
+  b.species = static_cast<size_t>(w[5]);
+  return b;
+}
+
+bool write_all(int fd, const std::vector<std::uint8_t>& data)
+{
+  size_t done = 0;
+  while (done < data.size()) {
+    const ssize_t n =
+        ::send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+void read_all(int fd, std::uint8_t* data, size_t size)
+{
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t n = ::recv(fd, data + done, size - done, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      throw std::runtime_error("Connessione con il processo vicino chiusa");
+    done += static_cast<size_t>(n);
+  }
+}
+
+void set_nodelay(int fd)
+{
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+} // namespace
+
+std::vector<std::uint8_t> encode_boids(const std::vector<Boid>& v)
+{
+  std::vector<std::uint8_t> out;
+  out.reserve(v.size() * boid_words * 4);
+  Words prev{};
+  for (const Boid& b : v) {
+    const Words w = to_words(b);
+    for (size_t k = 0; k < boid_words; ++k) {
+      const std::uint64_t x = w[k] ^ prev[k];
+      const size_t at       = out.size();
+      std::uint8_t mask     = 0;
+      out.push_back(0);
+      for (unsigned j = 0; j < 8; ++j) {
+        const auto byte = static_cast<std::uint8_t>(x >> (8 * j));
+        if (byte != 0) {
+          mask = static_cast<std::uint8_t>(mask | (1u << j));
+          out.push_back(byte);
+        }
+      }
+      out[at] = mask;
+    }
+    prev = w;
+  }
+  return out;
+}
+
+std::vector<Boid> decode_boids(const std::vector<std::uint8_t>& data)
+{
+  std::vector<Boid> res;
+  Words prev{};
+  size_t pos = 0;
+  auto next  = [&]() {
+    if (pos >= data.size())
+      throw std::runtime_error("Blocco di boids troncato");
+    return data[pos++];
+  };
+  while (pos < data.size()) {
+    Words w;
+    for (size_t k = 0; k < boid_words; ++k) {
+      const std::uint8_t mask = next();
+      std::uint64_t x         = 0;
+      for (unsigned j = 0; j < 8; ++j) {
+        if (mask & (1u << j))
+          x |= std::uint64_t{next()} << (8 * j);
+      }
+      w[k] = x ^ prev[k];
+    }
+    res.push_back(from_words(w));
+    prev = w;
+  }
+  return res;
+}
+
+size_t max_encoded_size(size_t n_boids)
+{
+  // una maschera e al più 8 byte per campo
+  return n_boids * boid_words * 9;
+}
+
+SocketChannel::SocketChannel(int fd_, size_t max_boids_)
+    : fd{fd_}
+    , max_boids{max_boids_}
+{
+  writer = std::thread([this]() { write_loop(); });
+}
+
+// il distruttore scrive ancora l'eventuale messaggio in attesa
+SocketChannel::~SocketChannel()
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    stop = true;
+  }
+  cv.notify_all();
+  writer.join();
+  ::close(fd);
+}
+
+void SocketChannel::write_loop()
+{
+  std::vector<std::uint8_t> in_flight;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      cv.wait(lock, [this]() { return has_pending || stop; });
+      if (!has_pending)
+        return;
+      in_flight.swap(pending);
+      has_pending = false;
+    }
+    cv.notify_all();
+    if (!write_all(fd, in_flight)) {
+      std::lock_guard<std::mutex> lock(m);
+      failed = true;
+    }
+  }
+}
+
+void SocketChannel::send(const std::vector<Boid>& v)
+{
+  const std::vector<std::uint8_t> payload = encode_boids(v);
+  std::vector<std::uint8_t> msg(header_size);
+  const std::array<std::uint32_t, 2> header{
+      static_cast<std::uint32_t>(v.size()),
+      static_cast<std::uint32_t>(payload.size())};
+  std::memcpy(msg.data(), header.data(), header_size);
+  msg.insert(msg.end(), payload.begin(), payload.end());
+
+  std::unique_lock<std::mutex> lock(m);
+  cv.wait(lock, [this]() { return !has_pending || failed; });
+  if (failed)
+    throw std::runtime_error("Invio al processo vicino non riuscito");
+  pending.swap(msg);
+  has_pending = true;
+  lock.unlock();
+  cv.notify_all();
+}
+
+void SocketChannel::receive(std::vector<Boid>& v)
+{
+  std::array<std::uint32_t, 2> header;
+  std::array<std::uint8_t, header_size> raw;
+  read_all(fd, raw.data(), header_size);
+  std::memcpy(header.data(), raw.data(), header_size);
+  // la lunghezza arriva dal vicino: si alloca solo entro i limiti dello
+  // stormo
+  if (header[0] > max_boids || header[1] > max_encoded_size(header[0]))
+    throw std::runtime_error("Blocco di boids troppo grande");
+  std::vector<std::uint8_t> payload(header[1]);
+  read_all(fd, payload.data(), payload.size());
+  const std::vector<Boid> block = decode_boids(payload);
+  if (block.size() != header[0])
+    throw std::runtime_error("Blocco di boids non valido");
+  v.insert(v.end(), block.begin(), block.end());
+}
+
+int tcp_listen(std::uint16_t port)
+{
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    throw std::runtime_error("Impossibile creare il socket");
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(port);
+  if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0
+      || listen(fd, 16) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Impossibile mettersi in ascolto sulla porta "
+                             + std::to_string(port));
+  }
+  return fd;
+}
+
+std::uint16_t local_port(int listen_fd)
+{
+  sockaddr_in addr{};
+  socklen_t len = sizeof(addr);
+  if (getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+    throw std::runtime_error("Porta del socket non disponibile");
+  return ntohs(addr.sin_port);
+}
+
+int tcp_accept(int listen_fd)
+{
+  int fd = -1;
+  do {
+    fd = accept(listen_fd, nullptr, nullptr);
+  } while (fd < 0 && errno == EINTR);
+  if (fd < 0)
+    throw std::runtime_error("Connessione in ingresso non riuscita");
+  set_nodelay(fd);
+  return fd;
+}
+
+int tcp_connect(const std::string& host, std::uint16_t port)
+{
+  addrinfo hints{};
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* list    = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &list)
+      != 0)
+    throw std::runtime_error("Indirizzo non valido: " + host);
+  int fd = -1;
+  for (addrinfo* ai = list; ai != nullptr && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(list);
+  if (fd < 0)
+    throw std::runtime_error("Connessione a " + host + " non riuscita");
+  set_nodelay(fd);
+  return fd;
+}
+
+std::array<int, 2> connected_pair(Transport t)
+{
+  std::array<int, 2> fds{-1, -1};
+  if (t == Transport::unix_socket) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) != 0)
+      throw std::runtime_error("Impossibile creare la coppia di socket");
+    return fds;
+  }
+  const int l = tcp_listen(0);
+  try {
+    fds[0] = tcp_connect("127.0.0.1", local_port(l));
+    fds[1] = tcp_accept(l);
+  } catch (...) {
+    if (fds[0] >= 0)
+      ::close(fds[0]);
+    ::close(l);
+    throw;
+  }
+  ::close(l);
+  return fds;
+}
+
+void run_socket_worker(DomainWorker& w, SocketChannel& left,
+                       SocketChannel& right, int frames, double dt)
+{
+  std::vector<Boid> out_left;
+  std::vector<Boid> out_right;
+  std::vector<Boid> in;
+  for (int f = 0; f < frames; ++f) {
+    w.collect_halo(out_left, out_right);
+    left.send(out_left);
+    right.send(out_right);
+    w.begin_step();
+    in.clear();
+    left.receive(in);
+    right.receive(in);
+    w.finish_step(in, dt);
+
+    w.collect_migrants(out_left, out_right);
+    left.send(out_left);
+    right.send(out_right);
+    in.clear();
+    left.receive(in);
+    right.receive(in);
+    w.receive(in);
+  }
+}
+
+std::vector<Boid> run_sockets(const std::vector<Boid>& b, size_t n_workers,
+                              Transport t, int frames, double dt, double d,
+                              double d_s, double s, double a, double c,
+                              const Position& world)
+{
+  if (frames < 0)
+    throw std::invalid_argument("Numero di frame non valido");
+  const StripPartition part(n_workers, world[0]);
+  if (part.min_width() < d)
+    throw std::invalid_argument("Le strisce devono essere larghe almeno "
+                                "quanto la distanza di interazione");
+
+  // links[r] unisce r (estremo 0, suo lato destro) a part.right(r)
+  // (estremo 1, suo lato sinistro); results[r] porta i boids finali al padre
+  std::vector<std::array<int, 2>> links;
+  std::vector<std::array<int, 2>> results;
+  for (size_t r = 0; r < n_workers; ++r) {
+    links.push_back(connected_pair(t));
+    results.push_back(connected_pair(Transport::unix_socket));
+  }
+
+  std::vector<pid_t> pids;
+  for (size_t r = 0; r < n_workers; ++r) {
+    const pid_t pid = fork();
+    if (pid < 0)
+      break;
+    if (pid == 0) {
+      // ogni figlio tiene solo i suoi estremi, così la chiusura di un
+      // processo arriva ai vicini come fine della connessione
+      const int right_fd  = links[r][0];
+      const int left_fd   = links[part.left(r)][1];
+      const int result_fd = results[r][1];
+      for (size_t k = 0; k < n_workers; ++k) {
+        for (const int fd : {links[k][0], links[k][1], results[k][0],
+                             results[k][1]}) {
+          if (fd != right_fd && fd != left_fd && fd != result_fd)
+            ::close(fd);
+        }
+      }
+      int status = 0;
+      try {
+        SocketChannel right(right_fd, b.size());
+        SocketChannel left(left_fd, b.size());
+        SocketChannel out(result_fd, b.size());
+        DomainWorker w(r, part, b, d, d_s, s, a, c, world);
+        run_socket_worker(w, left, right, frames, dt);
+        out.send(w.get_owned());
+      } catch (...) {
+        status = 1;
+      }
+      _exit(status);
+    }
+    pids.push_back(pid);
+  }
+
+  for (size_t r = 0; r < n_workers; ++r) {
+    ::close(links[r][0]);
+    ::close(links[r][1]);
+    ::close(results[r][1]);
+  }
+  std::vector<Boid> res;
+  bool ok = pids.size() == n_workers;
+  for (size_t r = 0; r < n_workers; ++r) {
+    SocketChannel in(results[r][0], b.size());
+    try {
+      if (ok)
+        in.receive(res);
+    } catch (const std::runtime_error&) {
+      ok = false;
+    }
+  }
+  for (const pid_t pid : pids) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      ok = false;
+  }
+  if (!ok)
+    throw std::runtime_error("Un processo della simulazione distribuita è "
+                             "terminato con errore");
+  return res;
+}
+
+} // namespace bd
@@ -0,0 +1,86 @@
+#ifndef SOCKET_TRANSPORT_HPP
+#define SOCKET_TRANSPORT_HPP
+
+#include "boid.hpp"
+#include "domain.hpp"
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bd {
+
+enum class Transport
+{
+  unix_socket, // coppie di socket locali (socketpair)
+  tcp          // connessioni TCP, anche tra macchine diverse
+};
+
+// compressione senza perdita di un blocco di boids: ogni campo a 64 bit va
+// in XOR con lo stesso campo del boid precedente (boids vicini hanno segno,
+// esponente e prime cifre uguali) e si trasmettono solo i byte non nulli,
+// preceduti da un byte con la maschera di quelli presenti
+std::vector<std::uint8_t> encode_boids(const std::vector<Boid>& v);
+// lancia std::runtime_error se i dati sono troncati
+std::vector<Boid> decode_boids(const std::vector<std::uint8_t>& data);
+// dimensione massima di encode_boids per n_boids boids
+size_t max_encoded_size(size_t n_boids);
+
+// canale verso un processo vicino su un socket connesso: ogni blocco di
+// boids è un solo messaggio (intestazione più dati compressi); l'invio usa
+// un doppio buffer svuotato da un thread dedicato, così chi chiama send
+// torna subito a calcolare mentre il messaggio precedente è in viaggio
+class SocketChannel
+{
+  int fd;
+  size_t max_boids; // limite dei blocchi ricevuti
+  std::thread writer;
+  std::mutex m;
+  std::condition_variable cv;
+  std::vector<std::uint8_t> pending; // prossimo messaggio da scrivere
+  bool has_pending = false;
+  bool stop        = false;
+  bool failed      = false;
+
+  void write_loop();
+
+ public:
+  // prende possesso del descrittore fd_; i blocchi in arrivo con più di
+  // max_boids_ boids (o più byte di quanti ne servano) vengono rifiutati
+  // prima di allocare
+  SocketChannel(int fd_, size_t max_boids_);
+  ~SocketChannel();
+  SocketChannel(const SocketChannel&)            = delete;
+  SocketChannel& operator=(const SocketChannel&) = delete;
+
+  void send(const std::vector<Boid>& v);
+  // attende il prossimo blocco e lo aggiunge in coda a v
+  void receive(std::vector<Boid>& v);
+};
+
+// apertura delle connessioni; port 0 sceglie una porta libera
+int tcp_listen(std::uint16_t port);
+std::uint16_t local_port(int listen_fd);
+int tcp_accept(int listen_fd);
+int tcp_connect(const std::string& host, std::uint16_t port);
+// due estremi connessi tra loro sulla stessa macchina (TCP su loopback)
+std::array<int, 2> connected_pair(Transport t);
+
+// ciclo di un processo: manda l'alone, calcola i boids interni mentre
+// l'alone dei vicini arriva, poi completa il frame e scambia i migranti;
+// ogni frame attende solo i due vicini, mai tutti i processi
+void run_socket_worker(DomainWorker& w, SocketChannel& left,
+                       SocketChannel& right, int frames, double dt);
+
+// come run_shared_memory, con processi locali collegati da socket
+std::vector<Boid> run_sockets(const std::vector<Boid>& b, size_t n_workers,
+                              Transport t, int frames, double dt, double d,
+                              double d_s, double s, double a, double c,
+                              const Position& world);
+
+} // namespace bd
+#endif
@@ -0,0 +1,56 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace bd {
+
+// coda lock-free a produttore e consumatore singoli tra thread dello stesso
+// processo: nessuna delle due operazioni attende, se la coda è piena
+// try_push fallisce e l'elemento resta al chiamante
+template <class T>
+class SpscQueue
+{
+  std::vector<T> slots;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head{0}; // scritto dal produttore
+  alignas(64) std::atomic<size_t> tail{0}; // scritto dal consumatore
+
+ public:
+  // capacity viene arrotondata alla potenza di due successiva
+  explicit SpscQueue(size_t capacity)
+  {
+    size_t n = 1;
+    while (n < capacity)
+      n *= 2;
+    slots.resize(n);
+    mask = n - 1;
+  }
+
+  bool try_push(T& x)
+  {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) > mask)
+      return false;
+    slots[h & mask] = std::move(x);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::optional<T> try_pop()
+  {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+      return std::nullopt;
+    std::optional<T> x{std::move(slots[t & mask])};
+    tail.store(t + 1, std::memory_order_release);
+    return x;
+  }
+};
+
+} // namespace bd
+#endif
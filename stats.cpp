@@ -0,0 +1,377 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace bd {
+
+namespace {
+
+// media e varianza con l'algoritmo di Welford, stabile anche su molte
+// coppie
+void welford(double x, double& mean, double& m2, double n)
+{
+  const double delta = x - mean;
+  mean += delta / n;
+  m2 += delta * (x - mean);
+}
+
+void speed_stats(const std::vector<Boid>& boids, FlockStats& st)
+{
+  double m2    = 0.;
+  double count = 0.;
+  for (const Boid& b : boids) {
+    count += 1.;
+    welford(std::hypot(b.vel[0], b.vel[1]), st.mean_speed, m2, count);
+  }
+  st.speed_std_dev = std::sqrt(m2 / count);
+}
+
+double distance(const Boid& a, const Boid& b)
+{
+  return std::hypot(a.pos[0] - b.pos[0], a.pos[1] - b.pos[1]);
+}
+
+// rettangolo che contiene i boids di una cella
+struct Box
+{
+  double x0 = std::numeric_limits<double>::max();
+  double y0 = std::numeric_limits<double>::max();
+  double x1 = std::numeric_limits<double>::lowest();
+  double y1 = std::numeric_limits<double>::lowest();
+
+  void add(const Position& p)
+  {
+    x0 = std::min(x0, p[0]);
+    y0 = std::min(y0, p[1]);
+    x1 = std::max(x1, p[0]);
+    y1 = std::max(y1, p[1]);
+  }
+};
+
+// distanza minima e massima tra un punto di a e uno di b
+std::array<double, 2> distance_range(const Box& a, const Box& b)
+{
+  const double gx = std::max({0., a.x0 - b.x1, b.x0 - a.x1});
+  const double gy = std::max({0., a.y0 - b.y1, b.y0 - a.y1});
+  const double fx = std::max(a.x1 - b.x0, b.x1 - a.x0);
+  const double fy = std::max(a.y1 - b.y0, b.y1 - a.y0);
+  return {std::hypot(gx, gy), std::hypot(fx, fy)};
+}
+
+} // namespace
+
+FlockStats compute_stats(int frame, const std::vector<Boid>& boids)
+{
+  FlockStats st;
+  st.frame   = frame;
+  st.n_boids = boids.size();
+  if (boids.size() < 2)
+    return st;
+  speed_stats(boids, st);
+
+  double m2    = 0.;
+  double count = 0.;
+  for (size_t i = 0; i < boids.size(); ++i) {
+    for (size_t j = i + 1; j < boids.size(); ++j) {
+      count += 1.;
+      welford(distance(boids[i], boids[j]), st.mean_distance, m2, count);
+    }
+  }
+  st.dist_std_dev = std::sqrt(m2 / count);
+  return st;
+}
+
+// Gli strati sono le coppie di celle di una griglia G x G: il numero di
+// coppie di ogni strato è esatto, e la distanza al suo interno è compresa
+// tra gli estremi dei rettangoli delle due celle. Con m_h campioni nello
+// strato h (peso w_h, ampiezza R_h) la disuguaglianza di Hoeffding dà
+// P(|errore| >= t) <= 2 exp(-2 t^2 / sum w_h^2 R_h^2 / m_h); scegliendo
+// m_h proporzionale a w_h R_h bastano M = (sum w_h R_h)^2 ln(2/delta) /
+// (2 t^2) campioni. Gli strati con meno coppie dei campioni assegnati si
+// contano esattamente. E[d^2] si ottiene esatta in O(n) dalla varianza
+// delle posizioni, e da essa il limite inferiore E[d] >= E[d^2] / d_max
+// che fissa t.
+FlockStats estimate_stats(int frame, const std::vector<Boid>& boids,
+                          double rel_error, double confidence,
+                          std::uint64_t seed)
+{
+  if (rel_error <= 0. || rel_error >= 1.)
+    throw std::invalid_argument(
+        "L'errore relativo deve essere compreso tra 0 e 1");
+  if (confidence <= 0. || confidence >= 1.)
+    throw std::invalid_argument("La confidenza deve essere compresa tra 0 e 1");
+  const size_t n = boids.size();
+  if (n < 3)
+    return compute_stats(frame, boids);
+
+  FlockStats st;
+  st.frame   = frame;
+  st.n_boids = n;
+  speed_stats(boids, st);
+
+  // sum_{i<j} |p_i - p_j|^2 = n sum_i |p_i - media|^2
+  double cx = 0.;
+  double cy = 0.;
+  Box all;
+  for (const Boid& b : boids) {
+    cx += b.pos[0];
+    cy += b.pos[1];
+    all.add(b.pos);
+  }
+  cx /= static_cast<double>(n);
+  cy /= static_cast<double>(n);
+  double spread = 0.;
+  for (const Boid& b : boids)
+    spread += (b.pos[0] - cx) * (b.pos[0] - cx)
+            + (b.pos[1] - cy) * (b.pos[1] - cy);
+  const double mean_sq = 2. * spread / static_cast<double>(n - 1);
+  const double d_max   = std::hypot(all.x1 - all.x0, all.y1 - all.y0);
+  if (mean_sq <= 0. || d_max <= 0.)
+    return st; // tutti nello stesso punto
+
+  const double pairs = static_cast<double>(n) * static_cast<double>(n - 1) / 2.;
+  const double log_term = std::log(2. / (1. - confidence));
+  auto samples_for      = [&](double range_sum, double t) {
+    return range_sum * range_sum * log_term / (2. * t * t);
+  };
+
+  // con G celle per lato le ampiezze scalano come 1/G e gli strati come
+  // G^4/2: G bilancia i due costi
+  double mean_low = mean_sq / d_max;
+  const double m1 = samples_for(d_max, rel_error * mean_low);
+  if (m1 >= pairs)
+    return compute_stats(frame, boids);
+  const size_t g = std::clamp<size_t>(
+      static_cast<size_t>(std::cbrt(std::sqrt(8. * m1))), 1,
+      std::min<size_t>(32, static_cast<size_t>(std::sqrt(n))));
+
+  // celle con ordinamento per conteggio, O(n)
+  const double w = all.x1 - all.x0;
+  const double h = all.y1 - all.y0;
+  auto axis_cell = [g](double v, double lo, double len) {
+    if (len <= 0.)
+      return size_t{0};
+    const auto k = static_cast<size_t>((v - lo) / len * static_cast<double>(g));
+    return std::min(k, g - 1);
+  };
+  std::vector<size_t> cell_of(n);
+  std::vector<size_t> start(g * g + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    const Position& p = boids[i].pos;
+    cell_of[i] = axis_cell(p[1], all.y0, h) * g + axis_cell(p[0], all.x0, w);
+    ++start[cell_of[i] + 1];
+  }
+  for (size_t k = 0; k < g * g; ++k)
+    start[k + 1] += start[k];
+  std::vector<size_t> order(n);
+  std::vector<size_t> fill(start.begin(), start.end() - 1);
+  std::vector<Box> boxes(g * g);
+  for (size_t i = 0; i < n; ++i) {
+    order[fill[cell_of[i]]++] = i;
+    boxes[cell_of[i]].add(boids[i].pos);
+  }
+  std::vector<size_t> occupied;
+  for (size_t k = 0; k < g * g; ++k)
+    if (start[k + 1] > start[k])
+      occupied.push_back(k);
+
+  struct Stratum
+  {
+    size_t a, b;
+    double weight, lo, hi;
+  };
+  auto for_each_stratum = [&](auto&& f) {
+    for (size_t ia = 0; ia < occupied.size(); ++ia) {
+      for (size_t ib = ia; ib < occupied.size(); ++ib) {
+        const size_t a  = occupied[ia];
+        const size_t b  = occupied[ib];
+        const auto na   = static_cast<double>(start[a + 1] - start[a]);
+        const auto nb   = static_cast<double>(start[b + 1] - start[b]);
+        const double np = a == b ? na * (na - 1.) / 2. : na * nb;
+        if (np <= 0.)
+          continue;
+        const auto [lo, hi] = distance_range(boxes[a], boxes[b]);
+        f(Stratum{a, b, np / pairs, a == b ? 0. : lo, hi}, np);
+      }
+    }
+  };
+
+  double range_sum = 0.;
+  double floor_sum = 0.;
+  for_each_stratum([&](const Stratum& s, double) {
+    range_sum += s.weight * (s.hi - s.lo);
+    floor_sum += s.weight * s.lo;
+  });
+  mean_low       = std::max(mean_low, floor_sum);
+  const double m = samples_for(range_sum, rel_error * mean_low);
+  if (m >= pairs)
+    return compute_stats(frame, boids);
+
+  std::mt19937_64 eng{seed};
+  double mean      = 0.;
+  double var_bound = 0.; // sum w_h^2 R_h^2 / m_h sugli strati campionati
+  for_each_stratum([&](const Stratum& s, double np) {
+    const size_t* pa = order.data() + start[s.a];
+    const size_t* pb = order.data() + start[s.b];
+    const size_t na  = start[s.a + 1] - start[s.a];
+    const size_t nb  = start[s.b + 1] - start[s.b];
+    const double range = s.hi - s.lo;
+    const double share = range_sum > 0. ? m * s.weight * range / range_sum : 0.;
+    const double m_h   = std::max(1., std::ceil(share));
+    double sum         = 0.;
+    if (m_h >= np) {
+      for (size_t x = 0; x < na; ++x)
+        for (size_t y = s.a == s.b ? x + 1 : 0; y < nb; ++y)
+          sum += distance(boids[pa[x]], boids[pb[y]]);
+      mean += s.weight * sum / np;
+      return;
+    }
+    std::uniform_int_distribution<size_t> pick_a(0, na - 1);
+    std::uniform_int_distribution<size_t> pick_b(0, s.a == s.b ? na - 2
+                                                               : nb - 1);
+    const auto k = static_cast<size_t>(m_h);
+    for (size_t r = 0; r < k; ++r) {
+      const size_t x = pick_a(eng);
+      size_t y       = pick_b(eng);
+      if (s.a == s.b && y >= x)
+        ++y;
+      sum += distance(boids[pa[x]], boids[pb[y]]);
+    }
+    mean += s.weight * sum / m_h;
+    var_bound += s.weight * s.weight * range * range / m_h;
+  });
+
+  st.mean_distance = mean;
+  st.dist_std_dev  = std::sqrt(std::max(0., mean_sq - mean * mean));
+  st.dist_error    = std::sqrt(log_term / 2. * var_bound);
+  return st;
+}
+
+size_t histogram_bin(size_t value)
+{
+  return static_cast<size_t>(std::bit_width(value));
+}
+
+FlockMetrics compute_metrics(const std::vector<Boid>& boids,
+                             const std::vector<int>& neighbor_count,
+                             ConcurrentUnionFind& uf)
+{
+  assert(uf.size() == boids.size());
+  assert(neighbor_count.size() == boids.size());
+  FlockMetrics m;
+  auto add = [](std::vector<size_t>& hist, size_t value) {
+    const size_t bin = histogram_bin(value);
+    if (hist.size() <= bin)
+      hist.resize(bin + 1, 0);
+    ++hist[bin];
+  };
+
+  std::vector<size_t> size(boids.size(), 0);
+  for (size_t i = 0; i < boids.size(); ++i)
+    ++size[uf.find(i)];
+  for (const size_t n : size) {
+    if (n > 0) {
+      ++m.n_clusters;
+      m.largest_cluster = std::max(m.largest_cluster, n);
+      add(m.cluster_sizes, n);
+    }
+  }
+
+  Velocity heading{0., 0.};
+  for (size_t i = 0; i < boids.size(); ++i) {
+    add(m.density, static_cast<size_t>(neighbor_count[i]));
+    const double speed = std::hypot(boids[i].vel[0], boids[i].vel[1]);
+    if (speed > 0.) {
+      heading[0] += boids[i].vel[0] / speed;
+      heading[1] += boids[i].vel[1] / speed;
+    }
+  }
+  if (!boids.empty())
+    m.polarization = std::hypot(heading[0], heading[1])
+                   / static_cast<double>(boids.size());
+  return m;
+}
+
+void print_stats(std::ostream& os, const FlockStats& st)
+{
+  os << "Frame " << st.frame << " | Vel. media: " << st.mean_speed
+     << " | Dev. std. vel.: " << st.speed_std_dev
+     << " | Dist. media: " << st.mean_distance;
+  if (st.dist_error > 0.)
+    os << " ± " << st.dist_error;
+  os << " | Dev. std. dist.: " << st.dist_std_dev << " | N_b: " << st.n_boids
+     << '\n';
+  if (!st.metrics)
+    return;
+  auto print_hist = [&os](const std::vector<size_t>& hist) {
+    os << '[';
+    for (size_t k = 0; k < hist.size(); ++k)
+      os << (k > 0 ? " " : "") << hist[k];
+    os << ']';
+  };
+  const FlockMetrics& m = *st.metrics;
+  os << "  Gruppi: " << m.n_clusters << " | Gruppo max: " << m.largest_cluster
+     << " | Polarizzazione: " << m.polarization << " | Dim. gruppi: ";
+  print_hist(m.cluster_sizes);
+  os << " | Densità: ";
+  print_hist(m.density);
+  os << '\n';
+}
+
+StatsWorker::StatsWorker(std::ostream* out_, double rel_error_)
+    : rel_error{rel_error_}
+    , out{out_}
+    , worker{[this]() { run(); }}
+{}
+
+StatsWorker::~StatsWorker()
+{
+  stop.store(true, std::memory_order_release);
+  signal.fetch_add(1, std::memory_order_release);
+  signal.notify_one();
+  worker.join();
+}
+
+void StatsWorker::run()
+{
+  std::uint64_t seen = 0;
+  while (true) {
+    signal.wait(seen, std::memory_order_acquire);
+    seen = signal.load(std::memory_order_acquire);
+    while (std::optional<Snapshot> snap = requests.try_pop()) {
+      FlockStats st =
+          estimate_stats(snap->frame, snap->boids, rel_error, 0.95,
+                         static_cast<std::uint64_t>(snap->frame));
+      st.metrics    = std::move(snap->metrics);
+      if (out != nullptr && st.n_boids >= 2)
+        print_stats(*out, st);
+      results.try_push(st);
+    }
+    if (stop.load(std::memory_order_acquire))
+      return;
+  }
+}
+
+bool StatsWorker::submit(int frame, const std::vector<Boid>& boids,
+                         const std::optional<FlockMetrics>& metrics)
+{
+  Snapshot snap{frame, boids, metrics};
+  if (!requests.try_push(snap))
+    return false;
+  signal.fetch_add(1, std::memory_order_release);
+  signal.notify_one();
+  return true;
+}
+
+std::optional<FlockStats> StatsWorker::poll()
+{
+  return results.try_pop();
+}
+
+} // namespace bd
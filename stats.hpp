@@ -0,0 +1,99 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "boid.hpp"
+#include "spsc_queue.hpp"
+#include "union_find.hpp"
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace bd {
+
+// misure dello stormo ricavate dal grafo dei vicini: i gruppi sono le
+// componenti connesse, gli istogrammi usano classi di potenze di due (la
+// classe k>0 conta i valori in [2^(k-1), 2^k), la classe 0 lo zero)
+struct FlockMetrics
+{
+  size_t n_clusters      = 0;
+  size_t largest_cluster = 0;
+  std::vector<size_t> cluster_sizes; // istogramma delle dimensioni dei gruppi
+  std::vector<size_t> density;       // istogramma del numero di vicini
+  double polarization = 0.; // |media delle direzioni|, 1 = tutti allineati
+};
+
+// statistiche dello stormo in un frame
+struct FlockStats
+{
+  int frame            = 0;
+  size_t n_boids       = 0;
+  double mean_speed    = 0.;
+  double speed_std_dev = 0.;
+  double mean_distance = 0.;
+  double dist_std_dev  = 0.;
+  double dist_error    = 0.; // semiampiezza dell'intervallo, 0 se esatta
+  std::optional<FlockMetrics> metrics;
+};
+
+// velocità media e distanza media tra tutte le coppie, con le deviazioni
+// standard (O(n^2) sulle coppie, accumulate senza salvare le distanze)
+FlockStats compute_stats(int frame, const std::vector<Boid>& boids);
+// come compute_stats, ma la distanza media è stimata campionando coppie
+// stratificate per celle, in O(n + campioni): con probabilità almeno
+// confidence l'errore è al più rel_error volte la distanza media, e
+// dist_error ne riporta il limite ottenuto; se i campioni necessari
+// superano le coppie il calcolo è esatto
+FlockStats estimate_stats(int frame, const std::vector<Boid>& boids,
+                          double rel_error, double confidence = 0.95,
+                          std::uint64_t seed = 0);
+// gruppi da uf (già unito lungo i lati del grafo) e densità dal numero di
+// vicini di ogni boid, in O(n)
+FlockMetrics compute_metrics(const std::vector<Boid>& boids,
+                             const std::vector<int>& neighbor_count,
+                             ConcurrentUnionFind& uf);
+size_t histogram_bin(size_t value);
+void print_stats(std::ostream& os, const FlockStats& st);
+
+// calcola le statistiche su un thread separato: submit copia lo stato e
+// ritorna subito, il thread calcola e stampa su out e pubblica i risultati
+// per poll; se le code sono piene la richiesta o il risultato si perde,
+// ma la simulazione non attende mai
+class StatsWorker
+{
+  struct Snapshot
+  {
+    int frame = 0;
+    std::vector<Boid> boids;
+    std::optional<FlockMetrics> metrics;
+  };
+
+  SpscQueue<Snapshot> requests{4};
+  SpscQueue<FlockStats> results{64};
+  std::atomic<std::uint64_t> signal{0}; // cresce a ogni richiesta
+  std::atomic<bool> stop{false};
+  double rel_error;
+  std::ostream* out;
+  std::thread worker;
+
+  void run();
+
+ public:
+  // out nullo: risultati solo tramite poll; le distanze sono stimate con
+  // errore relativo rel_error_ (vedi estimate_stats)
+  explicit StatsWorker(std::ostream* out_, double rel_error_ = 0.01);
+  ~StatsWorker();
+  StatsWorker(const StatsWorker&)            = delete;
+  StatsWorker& operator=(const StatsWorker&) = delete;
+
+  // falso se il thread ha ancora troppe richieste in sospeso; le metriche,
+  // se presenti, vengono allegate alle statistiche
+  bool submit(int frame, const std::vector<Boid>& boids,
+              const std::optional<FlockMetrics>& metrics = std::nullopt);
+  std::optional<FlockStats> poll();
+};
+
+} // namespace bd
+#endif
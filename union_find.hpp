@@ -0,0 +1,63 @@
+#ifndef UNION_FIND_HPP
+#define UNION_FIND_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace bd {
+
+// insiemi disgiunti con unione lock-free, usabili da più thread insieme:
+// la radice con indice maggiore viene sempre collegata a quella con indice
+// minore con una compare-exchange, e find dimezza il cammino
+class ConcurrentUnionFind
+{
+  std::vector<std::atomic<size_t>> parent;
+
+ public:
+  // n insiemi di un solo elemento; da chiamare senza altri thread attivi
+  void reset(size_t n)
+  {
+    parent = std::vector<std::atomic<size_t>>(n);
+    for (size_t k = 0; k < n; ++k)
+      parent[k].store(k, std::memory_order_relaxed);
+  }
+
+  size_t size() const
+  {
+    return parent.size();
+  }
+
+  size_t find(size_t x)
+  {
+    while (true) {
+      size_t p = parent[x].load(std::memory_order_acquire);
+      if (p == x)
+        return x;
+      const size_t gp = parent[p].load(std::memory_order_acquire);
+      if (gp != p)
+        parent[x].compare_exchange_weak(p, gp, std::memory_order_acq_rel);
+      x = gp;
+    }
+  }
+
+  void unite(size_t a, size_t b)
+  {
+    while (true) {
+      size_t ra = find(a);
+      size_t rb = find(b);
+      if (ra == rb)
+        return;
+      if (ra < rb)
+        std::swap(ra, rb);
+      size_t expected = ra;
+      if (parent[ra].compare_exchange_strong(expected, rb,
+                                             std::memory_order_acq_rel))
+        return;
+    }
+  }
+};
+
+} // namespace bd
+#endif